@@ -0,0 +1,69 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include "threadpool.h"
+
+/*
+空任务吞吐量: 一次从全局队列拿一个 vs 自适应批量 vs 固定批量
+先把任务全部提交(工作线程同时在取), 等全部执行完, 输出每秒执行的任务数
+*/
+
+class EmptyTask : public Task
+{
+public:
+    explicit EmptyTask(std::atomic_long *done) : done_(done) {}
+
+    Any run() override
+    {
+        done_->fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+private:
+    std::atomic_long *done_;
+};
+
+static double runOnce(int batch, int threads, long tasks)
+{
+    ThreadPool pool;
+    pool.setTaskQueMaxThreshHold(INT32_MAX);
+    pool.setDequeueBatch(batch);
+    pool.start(threads);
+
+    std::atomic_long done(0);
+    auto begin = std::chrono::steady_clock::now();
+    for (long i = 0; i < tasks; ++i)
+    {
+        pool.submitTask(std::make_shared<EmptyTask>(&done));
+    }
+    while (done.load() < tasks)
+    {
+        std::this_thread::yield();
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return tasks / sec;
+}
+
+// 用法: batch_dequeue_bench [任务数] [最大线程数]
+int main(int argc, char *argv[])
+{
+    ThreadPool::setLogEnabled(false);
+    long tasks = argc > 1 ? std::atol(argv[1]) : 1000000;
+    int maxThreads = argc > 2 ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+    std::cout << "cpu: " << std::thread::hardware_concurrency() << "  任务数: " << tasks << std::endl;
+
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        double single = runOnce(1, threads, tasks);
+        double adaptive = runOnce(0, threads, tasks);
+        double fixed = runOnce(DEQUEUE_BATCH_MAX, threads, tasks);
+        std::cout << "线程=" << threads
+            << "  K=1: " << (long)single << "/s"
+            << "  K=自适应: " << (long)adaptive << "/s (" << adaptive / single << "x)"
+            << "  K=" << DEQUEUE_BATCH_MAX << ": " << (long)fixed << "/s (" << fixed / single << "x)"
+            << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include "threadpool.h"
+#include "channel.h"
+
+/*
+通道吞吐量: 生产者和消费者都是线程池里的任务, 1:1 / N:1 / N:M
+线程池线程数可以比生产者+消费者少, 等待的任务帮忙执行排队的生产者/消费者, 或者睡下由线程池补偿线程
+最后一个生产者关闭通道, 核对消费者收到的数量和总和
+*/
+
+using Clock = std::chrono::steady_clock;
+
+struct Shared
+{
+    explicit Shared(size_t capacity, int producers) : ch_(capacity), producersLeft_(producers) {}
+
+    Channel<long> ch_;
+    std::atomic_int producersLeft_;
+    std::atomic_long received_{0};
+    std::atomic_long sum_{0};
+};
+
+class Producer : public Task
+{
+public:
+    Producer(std::shared_ptr<Shared> shared, long count) : shared_(shared), count_(count) {}
+
+    Any run() override
+    {
+        for (long i = 1; i <= count_; ++i)
+        {
+            shared_->ch_.send(i);
+        }
+        if (--shared_->producersLeft_ == 0)
+        {
+            shared_->ch_.close();
+        }
+        return 0;
+    }
+
+private:
+    std::shared_ptr<Shared> shared_;
+    long count_;
+};
+
+class Consumer : public Task
+{
+public:
+    explicit Consumer(std::shared_ptr<Shared> shared) : shared_(shared) {}
+
+    Any run() override
+    {
+        long value = 0;
+        long received = 0;
+        long sum = 0;
+        while (shared_->ch_.recv(value))
+        {
+            ++received;
+            sum += value;
+        }
+        shared_->received_ += received;
+        shared_->sum_ += sum;
+        return 0;
+    }
+
+private:
+    std::shared_ptr<Shared> shared_;
+};
+
+// 返回每秒传递的消息数, 核对不上返回-1
+static double runOnce(ThreadPool &pool, int producers, int consumers, long perProducer, size_t capacity)
+{
+    auto shared = std::make_shared<Shared>(capacity, producers);
+    std::vector<Result> results;
+    auto begin = Clock::now();
+    for (int i = 0; i < consumers; ++i)
+    {
+        results.push_back(pool.submitTask(std::make_shared<Consumer>(shared)));
+    }
+    for (int i = 0; i < producers; ++i)
+    {
+        results.push_back(pool.submitTask(std::make_shared<Producer>(shared, perProducer)));
+    }
+    for (Result &res : results)
+    {
+        res.get();
+    }
+    double sec = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    long total = perProducer * producers;
+    long expectSum = perProducer * (perProducer + 1) / 2 * producers;
+    if (shared->received_ != total || shared->sum_ != expectSum)
+    {
+        return -1;
+    }
+    return total / sec;
+}
+
+// 用法: channel_bench [每个生产者的消息数] [通道容量] [线程数]
+int main(int argc, char *argv[])
+{
+    ThreadPool::setLogEnabled(false);
+    long perProducer = argc > 1 ? std::atol(argv[1]) : 200000;
+    size_t capacity = argc > 2 ? std::atol(argv[2]) : 1024;
+    int threads = argc > 3 ? std::atoi(argv[3]) : std::thread::hardware_concurrency();
+    std::cout << "cpu: " << std::thread::hardware_concurrency() << "  线程: " << threads
+        << "  容量: " << capacity << "  每个生产者: " << perProducer << std::endl;
+
+    ThreadPool pool;
+    pool.setTaskQueMaxThreshHold(1024);
+    pool.start(threads);
+
+    const int configs[][2] = {{1, 1}, {4, 1}, {8, 1}, {4, 4}, {8, 8}};
+    bool ok = true;
+    for (const auto &config : configs)
+    {
+        double rate = runOnce(pool, config[0], config[1], perProducer, capacity);
+        ok = ok && rate > 0;
+        std::cout << config[0] << ":" << config[1] << "  "
+            << (rate > 0 ? std::to_string((long)rate) + "/s" : std::string("结果不对!")) << std::endl;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include "threadpool.h"
+
+/*
+过载时的尾延迟: 按固定速率提交, 速率是线程池处理能力的几倍
+对比 只按数量限制(提交阻塞, 最多等1s) 和 按排队时间拒绝(CoDel)
+延迟从调用submitTask开始算到任务执行完, 包括提交时阻塞的时间; 输出接受的任务的p50/p99和拒绝数量
+*/
+
+using Clock = std::chrono::steady_clock;
+
+class WorkTask : public Task
+{
+public:
+    WorkTask(Clock::time_point begin, std::chrono::microseconds cost, double *latencyMs)
+        : begin_(begin), cost_(cost), latencyMs_(latencyMs) {}
+
+    Any run() override
+    {
+        // 忙等模拟CPU工作
+        auto until = Clock::now() + cost_;
+        while (Clock::now() < until)
+        {
+        }
+        *latencyMs_ = std::chrono::duration<double, std::milli>(Clock::now() - begin_).count();
+        return 0;
+    }
+
+private:
+    Clock::time_point begin_;
+    std::chrono::microseconds cost_;
+    double *latencyMs_;
+};
+
+static double percentile(std::vector<double> &v, double p)
+{
+    if (v.empty())
+    {
+        return 0;
+    }
+    size_t k = std::min(v.size() - 1, (size_t)(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+// targetMs为0表示不打开CoDel
+static void runOnce(const char *name, int threads, int costUs, double overload, int seconds, int targetMs)
+{
+    ThreadPool pool;
+    pool.setTaskQueMaxThreshHold(1024);
+    if (targetMs > 0)
+    {
+        pool.setQueueDelayTarget(std::chrono::milliseconds(targetMs));
+    }
+    pool.start(threads);
+
+    // 提交间隔: 处理能力是 threads/cost, 乘上过载倍数
+    auto gap = std::chrono::nanoseconds((long)(costUs * 1000 / threads / overload));
+    long total = (long)(seconds * 1e9 / gap.count());
+    std::vector<double> latency(total, -1);
+    std::vector<Result> results;
+    results.reserve(total);
+
+    auto next = Clock::now();
+    for (long i = 0; i < total; ++i)
+    {
+        std::this_thread::sleep_until(next);
+        next += gap;
+        results.emplace_back(pool.submitTask(std::make_shared<WorkTask>(
+            Clock::now(), std::chrono::microseconds(costUs), &latency[i])));
+    }
+    std::vector<double> accepted;
+    long rejected = 0;
+    for (long i = 0; i < total; ++i)
+    {
+        if (results[i].isValid())
+        {
+            results[i].get();
+            accepted.push_back(latency[i]);
+        }
+        else
+        {
+            ++rejected;
+        }
+    }
+    PoolStats stats = pool.stats();
+    std::cout << name << "  提交: " << total << "  接受: " << accepted.size() << "  拒绝: " << rejected
+        << "  p50: " << percentile(accepted, 0.5) << "ms  p99: " << percentile(accepted, 0.99) << "ms"
+        << "  CoDel拒绝: " << stats.shedTasks_ << std::endl;
+}
+
+// 用法: codel_bench [工作线程数] [任务耗时us] [过载倍数] [秒数]
+int main(int argc, char *argv[])
+{
+    ThreadPool::setLogEnabled(false);
+    int threads = argc > 1 ? std::atoi(argv[1]) : 2;
+    int costUs = argc > 2 ? std::atoi(argv[2]) : 500;
+    double overload = argc > 3 ? std::atof(argv[3]) : 2.0;
+    int seconds = argc > 4 ? std::atoi(argv[4]) : 3;
+    std::cout << "工作线程: " << threads << "  任务耗时: " << costUs << "us  过载倍数: " << overload << std::endl;
+
+    runOnce("按数量阻塞  ", threads, costUs, overload, seconds, 0);
+    runOnce("CoDel 5ms  ", threads, costUs, overload, seconds, 5);
+    return 0;
+}
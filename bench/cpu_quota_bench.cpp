@@ -0,0 +1,141 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cmath>
+#include <ftw.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cpu_quota.h"
+
+/*
+在mkdtemp建的临时目录里放假的cgroup文件, 核对CpuQuota读出来的配额:
+v2的cpu.max(本进程cgroup和上层取小的、内容不对按不限制)、v1的cpu.cfs_quota_us/cpu.cfs_period_us
+再改文件看CpuQuotaWatcher会不会回调; 最后测一次available()的耗时, 监视线程每个周期调一次
+*/
+
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+    bool ok = true;
+
+    void check(bool cond, const std::string &what)
+    {
+        std::cout << (cond ? "通过  " : "失败  ") << what << std::endl;
+        ok = ok && cond;
+    }
+
+    void writeFile(const std::string &path, const std::string &content)
+    {
+        std::ofstream out(path, std::ios::trunc);
+        out << content << "\n";
+    }
+
+    int removeEntry(const char *path, const struct stat *, int, struct FTW *)
+    {
+        return remove(path);
+    }
+
+    // 按配额折算的CPU数, 和affinity取小
+    int expected(double quota)
+    {
+        int cpus = CpuQuota::affinityCpus();
+        return quota > 0 ? std::min(cpus, std::max(1, (int)std::ceil(quota))) : cpus;
+    }
+}
+
+int main()
+{
+    char dirTemplate[] = "/tmp/cpu_quota_XXXXXX";
+    if (mkdtemp(dirTemplate) == nullptr)
+    {
+        std::cerr << "mkdtemp失败" << std::endl;
+        return 1;
+    }
+    std::string root = dirTemplate;
+    std::cout << "临时目录: " << root << "  affinity: " << CpuQuota::affinityCpus() << std::endl;
+
+    // cgroup v2: 本进程在/app/inner, 配额设在/app上
+    std::string v2 = root + "/v2";
+    std::string v2Cgroup = root + "/v2.cgroup";
+    mkdir(v2.c_str(), 0755);
+    mkdir((v2 + "/app").c_str(), 0755);
+    mkdir((v2 + "/app/inner").c_str(), 0755);
+    writeFile(v2Cgroup, "0::/app/inner");
+    writeFile(v2 + "/cpu.max", "max 100000");
+    writeFile(v2 + "/app/cpu.max", "250000 100000");
+    writeFile(v2 + "/app/inner/cpu.max", "max 100000");
+    CpuQuota quotaV2(v2, v2Cgroup);
+    check(quotaV2.quotaCpus() == 2.5, "v2 上层的配额 2.5");
+    check(quotaV2.available() == expected(2.5), "v2 available() 向上取整到3, 不超过affinity");
+
+    writeFile(v2 + "/app/inner/cpu.max", "50000 100000");
+    check(quotaV2.quotaCpus() == 0.5, "v2 本层更小的配额 0.5");
+    check(quotaV2.available() == 1, "v2 available() 至少1");
+
+    writeFile(v2 + "/app/inner/cpu.max", "garbage 100000");
+    check(quotaV2.quotaCpus() == 2.5, "v2 内容不对的一层按不限制");
+
+    // cgroup v1: cpu和cpuacct挂在一起
+    std::string v1 = root + "/v1";
+    std::string v1Cgroup = root + "/v1.cgroup";
+    mkdir(v1.c_str(), 0755);
+    mkdir((v1 + "/cpu,cpuacct").c_str(), 0755);
+    mkdir((v1 + "/cpu,cpuacct/docker").c_str(), 0755);
+    writeFile(v1Cgroup, "5:memory:/docker\n4:cpu,cpuacct:/docker");
+    writeFile(v1 + "/cpu,cpuacct/cpu.cfs_quota_us", "-1");
+    writeFile(v1 + "/cpu,cpuacct/cpu.cfs_period_us", "100000");
+    writeFile(v1 + "/cpu,cpuacct/docker/cpu.cfs_quota_us", "150000");
+    writeFile(v1 + "/cpu,cpuacct/docker/cpu.cfs_period_us", "100000");
+    CpuQuota quotaV1(v1, v1Cgroup);
+    check(quotaV1.quotaCpus() == 1.5, "v1 配额 1.5");
+    check(quotaV1.available() == expected(1.5), "v1 available() 向上取整到2, 不超过affinity");
+
+    CpuQuota none(root + "/missing", root + "/missing.cgroup");
+    check(none.quotaCpus() == 0 && none.available() == CpuQuota::affinityCpus(), "没有cgroup文件时只看affinity");
+
+    // 监视: 配额从不限制改成1个CPU, 等回调
+    writeFile(v2 + "/app/cpu.max", "max 100000");
+    writeFile(v2 + "/app/inner/cpu.max", "max 100000");
+    if (CpuQuota::affinityCpus() > 1)
+    {
+        std::mutex mutex;
+        std::condition_variable cond;
+        int reported = 0;
+        CpuQuotaWatcher watcher(CpuQuota(v2, v2Cgroup), std::chrono::milliseconds(10), [&](int cpus)
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                reported = cpus;
+                cond.notify_all();
+            });
+        check(watcher.current() == CpuQuota::affinityCpus(), "监视开始时不限制");
+
+        writeFile(v2 + "/app/inner/cpu.max", "100000 100000");
+        std::unique_lock<std::mutex> lock(mutex);
+        bool fired = cond.wait_for(lock, std::chrono::seconds(2), [&]() -> bool { return reported != 0; });
+        check(fired && reported == 1, "配额改成1个CPU后回调1");
+    }
+    else
+    {
+        std::cout << "只有1个CPU, available()不会变, 跳过监视回调的检查" << std::endl;
+    }
+
+    // 监视线程每个周期读一次, 看看一次要多久
+    const int rounds = 10000;
+    auto begin = Clock::now();
+    int sink = 0;
+    for (int i = 0; i < rounds; ++i)
+    {
+        sink += quotaV2.available();
+    }
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - begin).count() / rounds;
+    std::cout << "available(): " << us << "us/次 (" << sink / rounds << ")" << std::endl;
+
+    nftw(root.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+    return ok ? 0 : 1;
+}
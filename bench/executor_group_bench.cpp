@@ -0,0 +1,111 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <sys/resource.h>
+#include "threadpool.h"
+#include "executor_group.h"
+
+/*
+三个线程池(rpc / compress / io)同时跑CPU任务
+对比: 各自独立按hardware_concurrency开线程  vs  加入一个执行组共享预算
+输出耗时和整个进程的上下文切换次数
+*/
+
+// 空转一段时间, 模拟CPU任务
+class SpinTask : public Task
+{
+public:
+    SpinTask(int micros) : micros_(micros) {}
+
+    Any run() override
+    {
+        auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(micros_);
+        unsigned long long n = 0;
+        while (std::chrono::steady_clock::now() < end)
+        {
+            ++n;
+        }
+        return n;
+    }
+
+private:
+    int micros_;
+};
+
+// 进程的上下文切换次数(主动 + 被动)
+static long contextSwitches()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+const int POOL_COUNT = 3;
+const int TASKS_PER_POOL = 2000;
+const int TASK_MICROS = 200;
+
+static void runTasks(ThreadPool *pools[])
+{
+    ResultSet results;
+    for (int i = 0; i < TASKS_PER_POOL; ++i)
+    {
+        for (int p = 0; p < POOL_COUNT; ++p)
+        {
+            results.add(pools[p]->submitTask(std::make_shared<SpinTask>(TASK_MICROS)));
+        }
+    }
+    results.wait_all();
+}
+
+static void report(const char *name, std::chrono::steady_clock::duration elapsed, long switches)
+{
+    std::cout << name
+        << "  耗时: " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << "ms"
+        << "  上下文切换: " << switches << std::endl;
+}
+
+// 用法: executor_group_bench [每个池线程数], 默认hardware_concurrency
+int main(int argc, char *argv[])
+{
+    ThreadPool::setLogEnabled(false);
+    int cores = std::thread::hardware_concurrency();
+    int threads = argc > 1 ? std::atoi(argv[1]) : cores;
+    const char *names[POOL_COUNT] = {"rpc", "compress", "io"};
+    std::cout << "cpu: " << cores << "  线程池: " << POOL_COUNT << "  每个池线程数: " << threads
+        << "  每个池任务数: " << TASKS_PER_POOL << "  任务耗时: " << TASK_MICROS << "us" << std::endl;
+
+    // 独立线程池, 一共 POOL_COUNT * threads 个线程抢cpu
+    {
+        ThreadPool pools[POOL_COUNT];
+        ThreadPool *ptrs[POOL_COUNT];
+        for (int p = 0; p < POOL_COUNT; ++p)
+        {
+            pools[p].setTaskQueMaxThreshHold(TASKS_PER_POOL);
+            pools[p].start(threads);
+            ptrs[p] = &pools[p];
+        }
+        long before = contextSwitches();
+        auto begin = std::chrono::steady_clock::now();
+        runTasks(ptrs);
+        report("独立线程池", std::chrono::steady_clock::now() - begin, contextSwitches() - before);
+    }
+
+    // 执行组, 同时执行的任务不超过cores个
+    {
+        ExecutorGroup group(cores);
+        ThreadPool *ptrs[POOL_COUNT];
+        for (int p = 0; p < POOL_COUNT; ++p)
+        {
+            ptrs[p] = &group.addPool(names[p], p < cores ? 1 : 0);
+            ptrs[p]->setTaskQueMaxThreshHold(TASKS_PER_POOL);
+            ptrs[p]->start(threads);
+        }
+        long before = contextSwitches();
+        auto begin = std::chrono::steady_clock::now();
+        runTasks(ptrs);
+        report("执行组    ", std::chrono::steady_clock::now() - begin, contextSwitches() - before);
+    }
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <sys/resource.h>
+#include "fiber.h"
+
+/*
+几万个任务同时阻塞在锁/条件变量/睡眠上, 纤程只占用户态栈, 工作线程只有几个
+输出: 全部挂起时的纤程数量、进程峰值内存, 以及从唤醒到全部执行完的耗时
+每个纤程占两段映射(栈 + 保护页), 纤程数量超过 vm.max_map_count/2 时要调大这个内核参数
+*/
+
+static FiberMutex mtx;
+static FiberCondition cond;
+static bool released = false;
+
+// 先睡一会儿, 再在条件变量上等主线程放行, 最后拿一下锁
+class BlockingTask : public Task
+{
+public:
+    Any run() override
+    {
+        FiberPool::sleepFor(std::chrono::milliseconds(10));
+        std::unique_lock<FiberMutex> lock(mtx);
+        cond.wait(lock, [] { return released; });
+        return 0;
+    }
+};
+
+// 进程峰值内存, MB
+static long maxRssMb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024;
+}
+
+// 用法: fiber_bench [纤程数量] [工作线程数] [栈大小KB]
+int main(int argc, char *argv[])
+{
+    ThreadPoolBase::setLogEnabled(false);
+    int fibers = argc > 1 ? std::atoi(argv[1]) : 20000;
+    int threads = argc > 2 ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+    size_t stackKb = argc > 3 ? std::atoi(argv[3]) : 64;
+    std::cout << "纤程数量: " << fibers << "  工作线程: " << threads << "  栈: " << stackKb << "KB" << std::endl;
+
+    FiberPool pool(stackKb * 1024);
+    pool.start(threads);
+
+    auto begin = std::chrono::steady_clock::now();
+    ResultSet results;
+    for (int i = 0; i < fibers; ++i)
+    {
+        results.add(pool.submitTask(std::make_shared<BlockingTask>()));
+    }
+    // 等所有纤程都挂在条件变量上
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    auto submitted = std::chrono::steady_clock::now();
+    std::cout << "挂起的纤程: " << pool.fiberSize()
+        << "  提交耗时: " << std::chrono::duration_cast<std::chrono::milliseconds>(submitted - begin).count() - 200 << "ms"
+        << "  峰值内存: " << maxRssMb() << "MB" << std::endl;
+
+    {
+        std::lock_guard<FiberMutex> guard(mtx);
+        released = true;
+    }
+    cond.notify_all();
+    results.wait_all();
+    std::cout << "唤醒到全部完成: "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - submitted).count()
+        << "ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include "threadpool.h"
+
+/*
+混合负载: 每个任务先算computeUs微秒, 再阻塞sleepUs微秒(模拟没有用blocking_scope包住的I/O)
+先用固定线程数扫一遍, 看吞吐量和线程数的关系; 再打开自动调整, 每个周期输出线程数和吞吐量, 看收敛过程
+提交线程一直保持队列里有积压
+*/
+
+using Clock = std::chrono::steady_clock;
+
+class MixedTask : public Task
+{
+public:
+    MixedTask(int computeUs, int sleepUs, std::atomic_long *done)
+        : computeUs_(computeUs), sleepUs_(sleepUs), done_(done) {}
+
+    Any run() override
+    {
+        auto until = Clock::now() + std::chrono::microseconds(computeUs_);
+        while (Clock::now() < until)
+        {
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(sleepUs_));
+        done_->fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+private:
+    int computeUs_;
+    int sleepUs_;
+    std::atomic_long *done_;
+};
+
+// 在pool上跑seconds秒, 每period输出一次(period为0不输出), 返回整体吞吐量
+// done要比pool活得久, 线程池析构时还会执行剩下的任务
+static double drive(ThreadPool &pool, std::atomic_long &done, int computeUs, int sleepUs, double seconds,
+                    std::chrono::milliseconds period)
+{
+    std::atomic_bool running(true);
+    std::thread producer([&]()
+        {
+            while (running)
+            {
+                // 保持积压, 但别让队列无限长
+                if (pool.stats().queuedTasks_ < 256)
+                {
+                    pool.submitTask(std::make_shared<MixedTask>(computeUs, sleepUs, &done));
+                }
+                else
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                }
+            }
+        });
+
+    auto begin = Clock::now();
+    auto end = begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    long lastDone = 0;
+    while (Clock::now() < end)
+    {
+        std::this_thread::sleep_for(period.count() > 0 ? period : std::chrono::milliseconds(100));
+        if (period.count() > 0)
+        {
+            long now = done.load();
+            std::cout << "  t=" << std::chrono::duration<double>(Clock::now() - begin).count() << "s"
+                << "  线程: " << pool.stats().threadSize_
+                << "  吞吐: " << (now - lastDone) * 1000 / period.count() << "/s" << std::endl;
+            lastDone = now;
+        }
+    }
+    double rate = done.load() / std::chrono::duration<double>(Clock::now() - begin).count();
+    running = false;
+    producer.join();
+    return rate;
+}
+
+// 用法: hill_climbing_bench [计算us] [阻塞us] [自动调整秒数] [最大线程数]
+int main(int argc, char *argv[])
+{
+    ThreadPool::setLogEnabled(false);
+    int computeUs = argc > 1 ? std::atoi(argv[1]) : 200;
+    int sleepUs = argc > 2 ? std::atoi(argv[2]) : 800;
+    double seconds = argc > 3 ? std::atof(argv[3]) : 15;
+    int maxThreads = argc > 4 ? std::atoi(argv[4]) : 64;
+    std::cout << "cpu: " << std::thread::hardware_concurrency()
+        << "  计算: " << computeUs << "us  阻塞: " << sleepUs << "us" << std::endl;
+
+    std::cout << "固定线程数:" << std::endl;
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        std::atomic_long done(0);
+        ThreadPool pool;
+        pool.setTaskQueMaxThreshHold(1024);
+        pool.start(threads);
+        std::cout << "  线程: " << threads << "  吞吐: "
+            << (long)drive(pool, done, computeUs, sleepUs, 1.0, std::chrono::milliseconds(0)) << "/s" << std::endl;
+    }
+
+    std::cout << "自动调整 [1, " << maxThreads << "], 从1个线程开始:" << std::endl;
+    std::atomic_long done(0);
+    ThreadPool pool;
+    pool.setTaskQueMaxThreshHold(1024);
+    pool.setAutoTune(1, maxThreads, std::chrono::milliseconds(500));
+    pool.start(1);
+    double rate = drive(pool, done, computeUs, sleepUs, seconds, std::chrono::milliseconds(500));
+    std::cout << "自动调整整体吞吐: " << (long)rate << "/s  最终线程: " << pool.stats().threadSize_ << std::endl;
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "threadpool.h"
+
+/*
+多个外部线程同时提交空任务: 不分片(都抢taskQueMutex_) vs 分片注入队列
+每个提交线程提交同样多的任务, 从开始提交到全部执行完, 输出每秒执行的任务数
+最后用一个工作线程检查每个提交线程的任务是不是按提交顺序执行的
+*/
+
+class EmptyTask : public Task
+{
+public:
+    explicit EmptyTask(std::atomic_long *done) : done_(done) {}
+
+    Any run() override
+    {
+        done_->fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+private:
+    std::atomic_long *done_;
+};
+
+// 记下执行到的序号, 和上一个比较
+class OrderTask : public Task
+{
+public:
+    OrderTask(long seq, long *last, std::atomic_long *errors)
+        : seq_(seq), last_(last), errors_(errors) {}
+
+    Any run() override
+    {
+        if (seq_ != *last_ + 1)
+        {
+            errors_->fetch_add(1);
+        }
+        *last_ = seq_;
+        return 0;
+    }
+
+private:
+    long seq_;
+    long *last_;
+    std::atomic_long *errors_;
+};
+
+static double runOnce(int shards, int producers, int threads, long perProducer)
+{
+    std::atomic_long done(0);
+    ThreadPool pool;
+    pool.setTaskQueMaxThreshHold(INT32_MAX);
+    pool.setInjectQueues(shards);
+    pool.start(threads);
+
+    long tasks = perProducer * producers;
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> submitters;
+    for (int p = 0; p < producers; ++p)
+    {
+        submitters.emplace_back([&]()
+            {
+                for (long i = 0; i < perProducer; ++i)
+                {
+                    pool.submitTask(std::make_shared<EmptyTask>(&done));
+                }
+            });
+    }
+    for (std::thread &t : submitters)
+    {
+        t.join();
+    }
+    while (done.load() < tasks)
+    {
+        std::this_thread::yield();
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return tasks / sec;
+}
+
+// 一个工作线程时出队顺序就是执行顺序, 每个提交线程的序号应该是连续的
+static long checkOrder(int shards, int producers, long perProducer)
+{
+    std::atomic_long errors(0);
+    std::vector<long> last(producers, -1);
+    {
+        ThreadPool pool;
+        pool.setTaskQueMaxThreshHold(INT32_MAX);
+        pool.setInjectQueues(shards);
+        pool.start(1);
+        std::vector<std::thread> submitters;
+        for (int p = 0; p < producers; ++p)
+        {
+            submitters.emplace_back([&, p]()
+                {
+                    for (long i = 0; i < perProducer; ++i)
+                    {
+                        pool.submitTask(std::make_shared<OrderTask>(i, &last[p], &errors));
+                    }
+                });
+        }
+        for (std::thread &t : submitters)
+        {
+            t.join();
+        }
+    } // 析构时执行完剩下的任务
+    return errors.load();
+}
+
+// 用法: inject_queue_bench [每个提交线程的任务数] [工作线程数] [注入队列数]
+int main(int argc, char *argv[])
+{
+    ThreadPool::setLogEnabled(false);
+    long perProducer = argc > 1 ? std::atol(argv[1]) : 20000;
+    int threads = argc > 2 ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+    int shards = argc > 3 ? std::atoi(argv[3]) : 16;
+    std::cout << "cpu: " << std::thread::hardware_concurrency() << "  工作线程: " << threads
+        << "  每个提交线程任务数: " << perProducer << "  注入队列: " << shards << std::endl;
+
+    for (int producers = 1; producers <= 64; producers *= 2)
+    {
+        double single = runOnce(0, producers, threads, perProducer);
+        double sharded = runOnce(shards, producers, threads, perProducer);
+        std::cout << "提交线程=" << producers
+            << "  不分片: " << (long)single << "/s"
+            << "  分片: " << (long)sharded << "/s (" << sharded / single << "x)" << std::endl;
+    }
+
+    long errors = checkOrder(shards, 8, perProducer / 4);
+    std::cout << "单个提交线程内的乱序: " << errors << std::endl;
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include "io_reactor.h"
+
+/*
+几千个连接(socketpair)同时做回显: 客户端写一条消息, 服务端读到后原样写回, 客户端读到后再发下一条
+所有读写都通过线程池的反应器, 工作线程只有几个, 不会阻塞在任何一个连接上
+输出总的往返次数和每秒往返次数
+*/
+
+struct Conn
+{
+    int client_;
+    int server_;
+    char clientBuf_[64];
+    char serverBuf_[64];
+    int rounds_;               // 客户端还要发几条
+};
+
+static const char MESSAGE[] = "ping-pong-message";
+
+// 服务端: 读到什么写回什么, 对端关闭时结束
+static void serve(IoReactor &io, Conn *conn)
+{
+    io.asyncRead(conn->server_, conn->serverBuf_, sizeof(conn->serverBuf_), [&io, conn](ssize_t n)
+        {
+            if (n <= 0)
+            {
+                return;
+            }
+            io.asyncWrite(conn->server_, conn->serverBuf_, n, [&io, conn](ssize_t)
+                {
+                    serve(io, conn);
+                });
+        });
+}
+
+// 客户端: 发一条, 等回显, 发完rounds_条后通知主线程
+static void ping(IoReactor &io, Conn *conn, CountDownLatch *finished)
+{
+    io.asyncWrite(conn->client_, MESSAGE, sizeof(MESSAGE), [&io, conn, finished](ssize_t)
+        {
+            io.asyncRead(conn->client_, conn->clientBuf_, sizeof(conn->clientBuf_), [&io, conn, finished](ssize_t n)
+                {
+                    if (n > 0 && --conn->rounds_ > 0)
+                    {
+                        ping(io, conn, finished);
+                    }
+                    else
+                    {
+                        finished->arrive();
+                    }
+                });
+        });
+}
+
+// 用法: io_reactor_bench [连接数] [每个连接往返次数] [工作线程数]
+int main(int argc, char *argv[])
+{
+    ThreadPool::setLogEnabled(false);
+    int conns = argc > 1 ? std::atoi(argv[1]) : 2000;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 50;
+    int threads = argc > 3 ? std::atoi(argv[3]) : 2;
+
+    // 每个连接两个fd
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    std::cout << "连接数: " << conns << "  每个连接往返: " << rounds << "  工作线程: " << threads << std::endl;
+
+    // 连接要比线程池活得久, 线程池析构时还会执行取消的回调
+    std::vector<std::unique_ptr<Conn>> all;
+    CountDownLatch finished;
+    for (int i = 0; i < conns; ++i)
+    {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        {
+            std::cerr << "socketpair失败, 连接数: " << i << std::endl;
+            return 1;
+        }
+        all.emplace_back(new Conn{fds[0], fds[1], {}, {}, rounds});
+    }
+
+    ThreadPool pool;
+    pool.start(threads);
+    IoReactor &io = pool.reactor();
+
+    auto begin = std::chrono::steady_clock::now();
+    for (auto &conn : all)
+    {
+        finished.expect();
+        serve(io, conn.get());
+        ping(io, conn.get(), &finished);
+    }
+    finished.waitAll();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+    long total = (long)conns * rounds;
+    std::cout << "往返: " << total << "  耗时: " << ms << "ms"
+        << "  每秒往返: " << (ms > 0 ? total * 1000 / ms : 0) << std::endl;
+
+    for (auto &conn : all)
+    {
+        io.cancel(conn->client_);
+        io.cancel(conn->server_);
+        close(conn->client_);
+        close(conn->server_);
+    }
+    return 0;
+}
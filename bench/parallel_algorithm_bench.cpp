@@ -0,0 +1,75 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include "parallel_algorithm.h"
+
+/*
+并行排序 / 前缀和 / transform_reduce  vs  std::sort / std::inclusive_scan / std::transform_reduce
+不同数据量和线程数, 输出耗时(ms)和加速比, 顺便检查结果是否一致
+*/
+
+template <typename Fn>
+static double timeMs(Fn fn)
+{
+    auto begin = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+static void report(const char *name, size_t n, int threads, double stdMs, double parMs, bool ok)
+{
+    std::cout << name << "  n=" << n << "  线程=" << threads
+        << "  std: " << stdMs << "ms  并行: " << parMs << "ms"
+        << "  加速比: " << stdMs / parMs << (ok ? "" : "  结果不一致!!") << std::endl;
+}
+
+// 用法: parallel_algorithm_bench [最大数据量] [最大线程数]
+int main(int argc, char *argv[])
+{
+    ThreadPool::setLogEnabled(false);
+    size_t maxSize = argc > 1 ? std::atol(argv[1]) : 10000000;
+    int maxThreads = argc > 2 ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+    std::cout << "cpu: " << std::thread::hardware_concurrency() << std::endl;
+
+    std::mt19937 rng(42);
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        ThreadPool pool;
+        pool.setTaskQueMaxThreshHold(1024);
+        pool.start(threads);
+        for (size_t n = 100000; n <= maxSize; n *= 10)
+        {
+            std::vector<int> data(n);
+            for (int &x : data)
+            {
+                x = rng();
+            }
+
+            // 排序
+            std::vector<int> expect = data;
+            std::vector<int> actual = data;
+            double stdMs = timeMs([&] { std::sort(expect.begin(), expect.end()); });
+            double parMs = timeMs([&] { parallelSort(pool, actual.begin(), actual.end()); });
+            report("sort     ", n, threads, stdMs, parMs, expect == actual);
+
+            // 前缀和, 用long long防溢出
+            std::vector<long long> values(data.begin(), data.end());
+            std::vector<long long> scanExpect(n), scanActual(n);
+            stdMs = timeMs([&] { std::inclusive_scan(values.begin(), values.end(), scanExpect.begin()); });
+            parMs = timeMs([&] { parallelInclusiveScan(pool, values.begin(), values.end(), scanActual.begin()); });
+            report("scan     ", n, threads, stdMs, parMs, scanExpect == scanActual);
+
+            // 平方和
+            long long sumExpect = 0, sumActual = 0;
+            auto square = [](int x) { return (long long)x * x / 1024; };
+            stdMs = timeMs([&] { sumExpect = std::transform_reduce(data.begin(), data.end(), 0LL, std::plus<>(), square); });
+            parMs = timeMs([&] { sumActual = parallelTransformReduce(pool, data.begin(), data.end(), 0LL, std::plus<>(), square); });
+            report("reduce   ", n, threads, stdMs, parMs, sumExpect == sumActual);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <sys/resource.h>
+#include "pipeline.h"
+
+/*
+合成的4阶段流水线: 读(串行按序) -> 解析(并行) -> 变换(并行) -> 写(串行按序)
+每个数据是一块缓冲, 不同令牌数下输出吞吐量和进程的峰值内存
+峰值内存只增不减, 所以令牌数从小到大跑, 每行看的是到目前为止的峰值
+*/
+
+struct Chunk
+{
+    int seq_;                    // 源头产生的序号, 写阶段用来检查顺序
+    std::vector<unsigned> data_;
+};
+using Block = std::shared_ptr<Chunk>;
+
+// 每个元素做rounds轮简单计算, 模拟解析/变换的开销
+static void churn(std::vector<unsigned> &data, int rounds)
+{
+    for (int r = 0; r < rounds; ++r)
+    {
+        for (unsigned &x : data)
+        {
+            x = x * 2654435761u + (x >> 13);
+        }
+    }
+}
+
+static long peakRssKb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// 用法: pipeline_bench [数据块数量] [每块KB] [工作线程数]
+int main(int argc, char *argv[])
+{
+    ThreadPool::setLogEnabled(false);
+    int blocks = argc > 1 ? std::atoi(argv[1]) : 2000;
+    size_t blockKb = argc > 2 ? std::atol(argv[2]) : 256;
+    int threads = argc > 3 ? std::atoi(argv[3]) : std::thread::hardware_concurrency();
+    size_t words = blockKb * 1024 / sizeof(unsigned);
+    std::cout << "数据块: " << blocks << "  每块: " << blockKb << "KB  工作线程: " << threads << std::endl;
+
+    ThreadPool pool;
+    pool.start(threads);
+
+    for (size_t tokens : {1, 2, 4, 8, 16, 64})
+    {
+        int produced = 0;
+        int written = 0;
+        bool inOrder = true;
+
+        Pipeline pipe;
+        pipe.setSource([&](Any &out) -> bool
+            {
+                if (produced == blocks)
+                {
+                    return false;
+                }
+                out = Block(new Chunk{produced, std::vector<unsigned>(words, produced)});
+                ++produced;
+                return true;
+            });
+        pipe.addStage(StageMode::PARALLEL, [](Any in) -> Any
+            {
+                Block block = in.cast_<Block>();
+                churn(block->data_, 4);
+                return block;
+            });
+        pipe.addStage(StageMode::PARALLEL, [](Any in) -> Any
+            {
+                Block block = in.cast_<Block>();
+                churn(block->data_, 2);
+                return block;
+            });
+        pipe.addStage(StageMode::SERIAL_IN_ORDER, [&](Any in) -> Any
+            {
+                Block block = in.cast_<Block>();
+                inOrder = inOrder && block->seq_ == written;
+                ++written;
+                return 0;
+            });
+
+        auto begin = std::chrono::steady_clock::now();
+        pipe.run(pool, tokens);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        double mb = (double)blocks * blockKb / 1024;
+        std::cout << "令牌: " << tokens << "  耗时: " << ms << "ms"
+            << "  吞吐: " << blocks * 1000 / ms << "块/s, " << mb * 1000 / ms << "MB/s"
+            << "  峰值内存: " << peakRssKb() / 1024 << "MB"
+            << (written == blocks && inOrder ? "" : "  顺序不对!!") << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include "threadpool.h"
+
+/*
+不同策略组合的空任务吞吐量: 默认配置 vs 后进先出+自旋+固定线程数 vs 按需增长 vs 带计数钩子
+钩子组合顺便核对onSubmit/onStart/onFinish的次数和任务数一致
+*/
+
+class EmptyTask : public Task
+{
+public:
+    explicit EmptyTask(std::atomic_long *done) : done_(done) {}
+
+    Any run() override
+    {
+        done_->fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+private:
+    std::atomic_long *done_;
+};
+
+// 钩子对象按值存在线程池里, 计数放在外面
+struct HookCounts
+{
+    std::atomic_long submitted_{0};
+    std::atomic_long started_{0};
+    std::atomic_long finished_{0};
+    std::atomic_long workers_{0};
+};
+
+// 数每个钩子被调用了几次
+struct CountingHooks
+{
+    explicit CountingHooks(HookCounts *counts = nullptr) : counts_(counts) {}
+
+    void onSubmit(Task &) { counts_->submitted_.fetch_add(1, std::memory_order_relaxed); }
+    void onStart(Task &) { counts_->started_.fetch_add(1, std::memory_order_relaxed); }
+    void onFinish(Task &) { counts_->finished_.fetch_add(1, std::memory_order_relaxed); }
+    void onWorkerStart(int) { counts_->workers_.fetch_add(1, std::memory_order_relaxed); }
+    void onWorkerExit(int) {}
+
+    HookCounts *counts_;
+};
+
+using LowLatencyPool = BasicThreadPool<NoHooks, LifoTaskQueue, SpinThenBlockWait<>,
+                                       std::allocator<std::shared_ptr<Task>>, FixedGrowth>;
+using ElasticPool = BasicThreadPool<NoHooks, FifoTaskQueue, BlockingWait,
+                                    std::allocator<std::shared_ptr<Task>>, CachedGrowth<>>;
+using CountingPool = BasicThreadPool<CountingHooks>;
+
+template <typename Pool>
+static double runOnce(Pool &pool, int threads, long tasks)
+{
+    pool.setTaskQueMaxThreshHold(INT32_MAX);
+    pool.start(threads);
+
+    std::atomic_long done(0);
+    auto begin = std::chrono::steady_clock::now();
+    for (long i = 0; i < tasks; ++i)
+    {
+        pool.submitTask(std::make_shared<EmptyTask>(&done));
+    }
+    while (done.load() < tasks)
+    {
+        std::this_thread::yield();
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return tasks / sec;
+}
+
+// 用法: policy_bench [任务数] [线程数]
+int main(int argc, char *argv[])
+{
+    ThreadPool::setLogEnabled(false);
+    long tasks = argc > 1 ? std::atol(argv[1]) : 1000000;
+    int threads = argc > 2 ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+    std::cout << "cpu: " << std::thread::hardware_concurrency() << "  线程: " << threads
+        << "  任务数: " << tasks << std::endl;
+
+    double base = 0;
+    {
+        ThreadPool pool;
+        base = runOnce(pool, threads, tasks);
+    }
+    std::cout << "默认(FIFO+阻塞等待+按模式): " << (long)base << "/s" << std::endl;
+
+    {
+        LowLatencyPool pool;
+        double rate = runOnce(pool, threads, tasks);
+        std::cout << "LIFO+自旋+固定线程数:      " << (long)rate << "/s (" << rate / base << "x)" << std::endl;
+    }
+
+    {
+        ElasticPool pool;
+        double rate = runOnce(pool, threads, tasks);
+        std::cout << "FIFO+阻塞等待+按需增长:    " << (long)rate << "/s (" << rate / base << "x)" << std::endl;
+    }
+
+    bool ok = true;
+    {
+        HookCounts hooks;
+        CountingPool pool{CountingHooks(&hooks)};
+        double rate = runOnce(pool, threads, tasks);
+        std::cout << "默认+计数钩子:             " << (long)rate << "/s (" << rate / base << "x)" << std::endl;
+
+        // done计数在任务里, onFinish在任务返回以后, 等钩子跟上
+        while (hooks.finished_.load() < tasks)
+        {
+            std::this_thread::yield();
+        }
+        ok = hooks.submitted_ == tasks && hooks.started_ == tasks && hooks.finished_ == tasks
+            && hooks.workers_ >= threads;
+        std::cout << "  钩子: submit=" << hooks.submitted_ << " start=" << hooks.started_
+            << " finish=" << hooks.finished_ << " worker=" << hooks.workers_
+            << (ok ? "  ok" : "  计数不对!") << std::endl;
+    }
+    return ok ? 0 : 1;
+}
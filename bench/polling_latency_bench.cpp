@@ -0,0 +1,103 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "threadpool.h"
+#include "polling_pool.h"
+
+/*
+从提交到任务开始执行的延迟: 普通线程池(锁 + 条件变量 + 内核唤醒)  vs  轮询线程池(SPSC通道 + 忙等)
+每次等上一个任务执行完、空闲一小会儿再提交下一个, 测的是空闲工作线程接到任务的延迟
+输出p50 / p99 / p99.9, 单位ns
+轮询线程要独占一个核才有意义, 单核机器上它和提交线程抢cpu, 结果没有参考价值
+*/
+
+static long long nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 记录开始执行的时刻和提交时刻之差
+class StampTask : public Task
+{
+public:
+    StampTask(long long submitNs, long long *latency)
+        : submitNs_(submitNs), latency_(latency) {}
+
+    Any run() override
+    {
+        *latency_ = nowNs() - submitNs_;
+        return 0;
+    }
+
+private:
+    long long submitNs_;
+    long long *latency_;
+};
+
+// 空转一段时间, 让工作线程回到空闲状态
+static void idleFor(int micros)
+{
+    long long end = nowNs() + micros * 1000LL;
+    while (nowNs() < end)
+    {
+    }
+}
+
+static void report(const char *name, std::vector<long long> &latency)
+{
+    std::sort(latency.begin(), latency.end());
+    auto at = [&](double q) { return latency[std::min(latency.size() - 1, (size_t)(q * latency.size()))]; };
+    std::cout << name
+        << "  p50: " << at(0.50) << "ns"
+        << "  p99: " << at(0.99) << "ns"
+        << "  p99.9: " << at(0.999) << "ns"
+        << "  max: " << latency.back() << "ns" << std::endl;
+}
+
+const int GAP_MICROS = 20;
+
+// 用法: polling_latency_bench [采样次数] [轮询线程绑定的cpu]
+int main(int argc, char *argv[])
+{
+    ThreadPool::setLogEnabled(false);
+    int samples = argc > 1 ? std::atoi(argv[1]) : 20000;
+    std::vector<int> cpus;
+    if (argc > 2)
+    {
+        cpus.push_back(std::atoi(argv[2]));
+    }
+    std::cout << "cpu: " << std::thread::hardware_concurrency() << "  采样次数: " << samples
+        << "  提交间隔: " << GAP_MICROS << "us" << std::endl;
+
+    // 普通线程池, 一个工作线程
+    {
+        ThreadPool pool;
+        pool.start(1);
+        std::vector<long long> latency(samples);
+        for (int i = 0; i < samples; ++i)
+        {
+            idleFor(GAP_MICROS);
+            pool.submitTask(std::make_shared<StampTask>(nowNs(), &latency[i])).get();
+        }
+        report("普通线程池", latency);
+    }
+
+    // 轮询线程池, 一个轮询线程一个通道
+    {
+        PollingPool pool(1, cpus);
+        PollingLane &lane = pool.addLane();
+        pool.start();
+        std::vector<long long> latency(samples);
+        for (int i = 0; i < samples; ++i)
+        {
+            idleFor(GAP_MICROS);
+            lane.submitTask(std::make_shared<StampTask>(nowNs(), &latency[i])).get();
+        }
+        report("轮询线程池", latency);
+    }
+
+    return 0;
+}
@@ -0,0 +1,202 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "threadpool.h"
+#include "shm_queue.h"
+
+/*
+跨进程提交: 提交进程通过共享内存队列把请求交给线程池进程, 结果从完成环读回来
+请求是一段字节, 线程池进程算校验和写回8个字节, 提交方核对每个结果
+不带参数: 先建好memfd队列再fork, 子进程当提交方, 父进程当线程池进程
+server NAME / client NAME: 分成两个独立的进程跑, 先启动server
+*/
+
+using Clock = std::chrono::steady_clock;
+
+const uint32_t TYPE_CHECKSUM = 1;
+
+static uint64_t checksum(const char *data, uint32_t size)
+{
+    uint64_t sum = 1469598103934665603ull;
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        sum = (sum ^ (unsigned char)data[i]) * 1099511628211ull;
+    }
+    return sum;
+}
+
+// 线程池进程的处理函数: 校验和原地写回
+static int32_t handle(ShmRequest &req)
+{
+    if (req.type_ != TYPE_CHECKSUM || req.capacity_ < sizeof(uint64_t))
+    {
+        return -1;
+    }
+    uint64_t sum = checksum(req.data_, req.size_);
+    memcpy(req.data_, &sum, sizeof(sum));
+    req.resultSize_ = sizeof(sum);
+    return 0;
+}
+
+// 提交方: 保持window个请求在途, 返回出错的数量
+static long runClient(ShmQueue &que, uint32_t client, long requests, uint32_t payload, int window)
+{
+    std::vector<char> buf(payload);
+    std::vector<uint64_t> expect(window);
+    long errors = 0;
+    long sent = 0;
+    long received = 0;
+    auto begin = Clock::now();
+    while (received < requests)
+    {
+        while (sent < requests && sent - received < window)
+        {
+            for (uint32_t i = 0; i < payload; ++i)
+            {
+                buf[i] = (char)(sent * 31 + i);
+            }
+            if (!que.submit(client, sent, TYPE_CHECKSUM, buf.data(), payload))
+            {
+                break; // 数据块用完了, 先收结果
+            }
+            expect[sent % window] = checksum(buf.data(), payload);
+            ++sent;
+        }
+        if (sent == received)
+        {
+            // 数据块都被别的提交方拿着
+            std::this_thread::yield();
+            continue;
+        }
+        ShmCompletion done;
+        if (!que.waitComplete(client, done, std::chrono::milliseconds(1000)))
+        {
+            std::cerr << "等结果超时" << std::endl;
+            return errors + requests - received;
+        }
+        uint64_t sum = 0;
+        memcpy(&sum, que.data(done.offset_), sizeof(sum));
+        if (done.status_ != 0 || done.size_ != sizeof(sum) || sum != expect[done.id_ % window])
+        {
+            ++errors;
+        }
+        que.release(done.offset_);
+        ++received;
+    }
+    double sec = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::cout << "提交方" << client << ": " << requests << "个请求, " << (long)(requests / sec) << "/s, 错误: "
+        << errors << std::endl;
+    return errors;
+}
+
+// 线程池进程自己提交的任务
+class LocalTask : public Task
+{
+public:
+    explicit LocalTask(std::atomic_long *done) : done_(done) {}
+
+    Any run() override
+    {
+        done_->fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+private:
+    std::atomic_long *done_;
+};
+
+// 线程池进程: 一边执行共享内存来的请求, 一边执行本进程自己提交的任务
+static void runServer(ShmQueue &que, int threads, double seconds)
+{
+    ThreadPool pool;
+    pool.setTaskQueMaxThreshHold(4096);
+    pool.start(threads);
+    ShmTaskServer server(que, handle);
+    server.start(pool);
+
+    std::atomic_long local(0);
+    auto end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    while (Clock::now() < end)
+    {
+        pool.submitTask(std::make_shared<LocalTask>(&local));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    server.stop();
+    std::cout << "线程池进程: 共享内存请求 " << server.served() << "个, 本进程任务 " << local.load() << "个" << std::endl;
+}
+
+// 用法: shm_queue_bench [请求数] [负载字节数]
+//      shm_queue_bench server NAME [秒数]      shm_queue_bench client NAME [提交方编号] [请求数]
+int main(int argc, char *argv[])
+{
+    ThreadPool::setLogEnabled(false);
+    int threads = std::thread::hardware_concurrency();
+
+    if (argc > 2 && strcmp(argv[1], "server") == 0)
+    {
+        auto que = ShmQueue::create(argv[2], ShmQueueOptions());
+        if (que == nullptr)
+        {
+            return 1;
+        }
+        runServer(*que, threads, argc > 3 ? std::atof(argv[3]) : 10);
+        return 0;
+    }
+    if (argc > 2 && strcmp(argv[1], "client") == 0)
+    {
+        auto que = ShmQueue::open(argv[2]);
+        if (que == nullptr)
+        {
+            return 1;
+        }
+        uint32_t client = argc > 3 ? std::atoi(argv[3]) : 0;
+        long requests = argc > 4 ? std::atol(argv[4]) : 100000;
+        return runClient(*que, client, requests, 256, 64) == 0 ? 0 : 1;
+    }
+
+    long requests = argc > 1 ? std::atol(argv[1]) : 200000;
+    uint32_t payload = argc > 2 ? std::atoi(argv[2]) : 256;
+    auto que = ShmQueue::create("", ShmQueueOptions());
+    if (que == nullptr)
+    {
+        return 1;
+    }
+
+    // 先fork再起线程
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        auto child = ShmQueue::openFd(dup(que->fd()));
+        long errors = child == nullptr ? 1 : runClient(*child, 0, requests, payload, 64);
+        _exit(errors == 0 ? 0 : 1);
+    }
+
+    std::atomic_bool clientDone(false);
+    int status = 0;
+    std::thread reaper([&]()
+        {
+            waitpid(pid, &status, 0);
+            clientDone = true;
+        });
+    {
+        ThreadPool pool;
+        pool.setTaskQueMaxThreshHold(4096);
+        pool.start(threads);
+        ShmTaskServer server(*que, handle);
+        server.start(pool);
+        while (!clientDone)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        server.stop();
+        std::cout << "线程池进程执行了 " << server.served() << "个共享内存请求" << std::endl;
+    }
+    reaper.join();
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : 1;
+}
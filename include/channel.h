@@ -0,0 +1,173 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+#include "threadpool.h"
+
+/*
+**********************************example**************************
+auto ch = std::make_shared<Channel<int>>(64);
+pool.submitTask(std::make_shared<Producer>(ch));   // for (...) ch->send(x); ch->close();
+pool.submitTask(std::make_shared<Consumer>(ch));   // int x; while (ch->recv(x)) { ... }
+
+if (!ch->trySend(x)) { ... }                       // 满了或者关闭了, 马上返回
+*/
+
+// 有界的多生产者多消费者通道, 任务之间传一串结果用
+// send在满的时候等, recv在空的时候等; 在工作线程里等的时候先帮忙执行本线程本地队列和全局队列里的任务,
+// 没有任务可执行或者帮忙的层数到了HELP_DEPTH_MAX, 就进入阻塞区睡下, 有任务排队时线程池补偿一个线程去执行
+// 帮忙执行的任务压在等待的任务上面, 它反过来等这个通道时, 压在下面的等不到机会取/放
+// 所以同一边还有别的等待者在睡(没有被压住)时才帮忙, 任何时候同一边至少留一个能被叫醒的, 8个生产者1个消费者也不会卡死
+// close以后send失败, recv把剩下的取完再返回false
+template <typename T>
+class Channel
+{
+public:
+    explicit Channel(size_t capacity)
+        : capacity_(capacity > 0 ? capacity : 1), sendParked_(0), recvParked_(0), closed_(false)
+    {}
+
+    Channel(const Channel &) = delete;
+    Channel &operator=(const Channel &) = delete;
+
+    // 满了或者已经关闭返回false, 不等
+    bool trySend(T value)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (closed_ || que_.size() >= capacity_)
+        {
+            return false;
+        }
+        push(lock, std::move(value));
+        return true;
+    }
+
+    // 满了等到有空位, 已经关闭(包括等的时候被关闭)返回false
+    bool send(T value)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        waitUntil(lock, notFull_, sendParked_, [&]() -> bool { return closed_ || que_.size() < capacity_; });
+        if (closed_)
+        {
+            return false;
+        }
+        push(lock, std::move(value));
+        return true;
+    }
+
+    // 空了返回false, 不等
+    bool tryRecv(T &value)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (que_.empty())
+        {
+            return false;
+        }
+        pop(lock, value);
+        return true;
+    }
+
+    // 空了等到有数据, 关闭并且取完了返回false
+    bool recv(T &value)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        waitUntil(lock, notEmpty_, recvParked_, [&]() -> bool { return closed_ || !que_.empty(); });
+        if (que_.empty())
+        {
+            return false;
+        }
+        pop(lock, value);
+        return true;
+    }
+
+    // 关闭通道, 叫醒所有在等的send/recv; 重复关闭没有影响
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            closed_ = true;
+        }
+        notFull_.notify_all();
+        notEmpty_.notify_all();
+    }
+
+    bool isClosed() const
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return closed_;
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return que_.size();
+    }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    void push(std::unique_lock<std::mutex> &lock, T &&value)
+    {
+        que_.emplace_back(std::move(value));
+        lock.unlock();
+        notEmpty_.notify_one();
+    }
+
+    void pop(std::unique_lock<std::mutex> &lock, T &value)
+    {
+        value = std::move(que_.front());
+        que_.pop_front();
+        lock.unlock();
+        notFull_.notify_one();
+    }
+
+    // 等到pred成立, 返回时lock持有
+    // parked: 这一边在条件变量上睡着的等待者数量, mutex_保护
+    // 帮忙执行的任务和进出阻塞区都要拿线程池的锁, 还可能等执行组的名额, 都放在通道的锁外面
+    template <typename Pred>
+    void waitUntil(std::unique_lock<std::mutex> &lock, std::condition_variable &cond, size_t &parked, Pred pred)
+    {
+        // 每执行完一个任务、离开阻塞区的时候都可能又被别人抢走了, 再看一次
+        while (!pred())
+        {
+            if (parked > 0 && ThreadPoolBase::isWorkerThread())
+            {
+                lock.unlock();
+                bool ran = ThreadPoolBase::runPendingTask();
+                lock.lock();
+                if (ran)
+                {
+                    continue;
+                }
+                if (pred())
+                {
+                    break;
+                }
+            }
+
+            ++parked;
+            lock.unlock();
+            {
+                ThreadPoolBase::blocking_scope blocking;
+                std::unique_lock<std::mutex> waitLock(mutex_);
+                cond.wait(waitLock, pred);
+                --parked;
+            }
+            lock.lock();
+        }
+    }
+
+    const size_t capacity_;
+    mutable std::mutex mutex_;
+    std::condition_variable notFull_;
+    std::condition_variable notEmpty_;
+    std::deque<T> que_;
+    size_t sendParked_;  // 睡着等空位的send数量
+    size_t recvParked_;  // 睡着等数据的recv数量
+    bool closed_;
+};
+
+#endif
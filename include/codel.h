@@ -0,0 +1,67 @@
+#ifndef CODEL_H
+#define CODEL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+/*
+**********************************example**************************
+ThreadPool pool;
+pool.setQueueDelayTarget(std::chrono::milliseconds(5));  // 排队时间持续超过5ms就开始拒绝
+pool.start(4);
+Result res = pool.submitTask(task);
+if (!res.isValid()) { ... 过载了, 直接给调用方返回错误 ... }
+PoolStats stats = pool.stats();                          // shedTasks_/overloaded_/minQueueDelayNs_
+*/
+
+// CoDel式的准入控制: 看任务在队列里等了多久, 而不是队列有多长
+// 任务出队时报告排队时间, 每个区间(interval)结束时看这个区间里最小的排队时间
+// 最小值都超过目标(target), 说明队列一直排不空, 是持续的过载而不是突发, 进入过载状态
+// 过载期间按队列长度和出队速度估算新任务的排队时间, 超过目标就拒绝, 队列的排队时间维持在目标附近
+// 拒绝是马上返回的, 不像按数量限制那样阻塞提交者
+class CoDelController
+{
+public:
+    CoDelController();
+
+    // target为0表示关闭
+    void setTarget(std::chrono::nanoseconds target, std::chrono::nanoseconds interval);
+    bool isEnabled() const { return targetNs_ > 0; }
+
+    // 一个任务出队, delay是它在队列里等的时间
+    void onDequeue(std::chrono::nanoseconds delay);
+
+    // 队列里已经有queued个任务, 能不能再接受一个, 拒绝的话计数
+    bool admit(size_t queued);
+
+    bool isOverloaded() const { return overloaded_; }
+
+    // 拒绝的任务数量
+    uint64_t shedCount() const { return shed_; }
+
+    // 上一个区间的最小排队时间
+    int64_t minDelayNs() const { return lastMinDelayNs_; }
+
+    static int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    int64_t targetNs_;
+    int64_t intervalNs_;
+    std::atomic<int64_t> intervalEnd_;      // 当前区间结束的时刻
+    std::atomic<int64_t> minDelayNs_;       // 当前区间的最小排队时间
+    std::atomic<int64_t> lastMinDelayNs_;   // 上一个区间的最小排队时间
+    uint64_t shedMark_;                     // 上一个区间结束时的拒绝数量, 做判断的线程才用
+    std::atomic<uint64_t> dequeued_;        // 当前区间出队的任务数量
+    std::atomic<int64_t> nsPerDequeue_;     // 上一个区间平均多久出队一个
+    std::atomic_bool resetting_;            // 有一个线程在做区间结束的判断
+    std::atomic_bool overloaded_;
+    std::atomic<uint64_t> shed_;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef CPU_QUOTA_H
+#define CPU_QUOTA_H
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+
+// cgroup文件系统默认挂载点
+const char *const CGROUP_ROOT = "/sys/fs/cgroup";
+
+// 本进程所在的cgroup, 每行 "层级号:控制器列表:路径", v2那行是 "0::/路径"
+const char *const PROC_SELF_CGROUP = "/proc/self/cgroup";
+
+/*
+**********************************example**************************
+ThreadPool pool;
+pool.watchCpuQuota();      // 配额变了就跟着调整线程数
+pool.start();              // 默认线程数 = CpuQuota().available(), 不是宿主机的核数
+
+// 测试: 在临时目录里放假的cgroup文件
+// /tmp/fake/cpu.max 写 "250000 100000"  ->  CpuQuota("/tmp/fake").available() == 3 (affinity允许的CPU够的话)
+// 再给一个假的cgroup文件写 "0::/app", /tmp/fake/app/cpu.max 也会读, 取两层里小的
+*/
+
+// 进程实际能用的CPU数量, 容器里hardware_concurrency()报的是宿主机的核数
+// 取 sched_getaffinity允许的CPU数 和 cgroup配额(quota/period, 向上取整, 至少1) 的较小值
+// 按procCgroup找到本进程的cgroup路径, 从<root>下的这个目录往上到<root>逐级读, 取最小的配额
+// cgroup v2读cpu.max, v1读<root>/cpu/(或cpu,cpuacct)下的cpu.cfs_quota_us和cpu.cfs_period_us
+// 目录不存在的层跳过, 所以容器里<root>就是本容器cgroup的情况也能读到; 都读不到或者没有限制时只看affinity
+class CpuQuota
+{
+public:
+    explicit CpuQuota(std::string root = CGROUP_ROOT, const std::string &procCgroup = PROC_SELF_CGROUP);
+
+    // 可用的CPU数量, 至少1
+    int available() const;
+
+    // cgroup配额折算成的CPU数(可以是小数), 没有限制或者读不到返回0
+    double quotaCpus() const;
+
+    // sched_getaffinity允许的CPU数量, 失败时用hardware_concurrency
+    static int affinityCpus();
+
+    // 线程池默认的线程数量
+    static int defaultConcurrency() { return CpuQuota().available(); }
+
+private:
+    std::string root_;
+    std::string v2Path_; // 本进程在v2层级里的路径, 根是空串
+    std::string v1Path_; // 本进程在v1 cpu控制器层级里的路径, 根是空串
+};
+
+// 定期重新读配额, 变了就回调新的CPU数量
+// 回调在监视线程上执行, 析构时等监视线程退出
+class CpuQuotaWatcher
+{
+public:
+    CpuQuotaWatcher(CpuQuota quota, std::chrono::milliseconds period, std::function<void(int)> onChange);
+    ~CpuQuotaWatcher();
+
+    CpuQuotaWatcher(const CpuQuotaWatcher &) = delete;
+    CpuQuotaWatcher &operator=(const CpuQuotaWatcher &) = delete;
+
+    // 最近一次读到的CPU数量
+    int current() const { return current_; }
+
+private:
+    void loop();
+
+    CpuQuota quota_;
+    std::chrono::milliseconds period_;
+    std::function<void(int)> onChange_;
+    int current_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stop_;                    // mutex_保护
+    std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef EXECUTOR_GROUP_H
+#define EXECUTOR_GROUP_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+#include "threadpool.h"
+
+// 执行组里的一个线程池
+struct ExecutorSlot
+{
+    std::string name_;                // 线程池名字
+    int minConcurrency_;              // 保证能同时执行的任务数量
+    int active_;                      // 正在执行的任务数量, 组的mutex_保护
+    int waiters_;                     // 这个池里在等名额的线程数量, 组的mutex_保护
+    std::condition_variable cond_;    // 这个池的线程在这里等名额, 只叫醒一个, 不惊群
+    std::unique_ptr<ThreadPool> pool_;
+};
+
+/*
+**********************************example**************************
+ExecutorGroup group(8);                        // 整个进程最多同时执行8个任务
+ThreadPool &rpc = group.addPool("rpc", 2);     // 至少保证2个
+ThreadPool &io = group.addPool("io", 1);
+rpc.start(8);                                  // 线程可以比预算多, 多出来的在等执行名额
+io.start(8);
+rpc.submitTask(std::make_shared<MyTask>());
+*/
+
+// 执行组: 多个命名线程池共享一个全局的并发预算
+// 工作线程拿到任务后先要一个执行名额, 没有任务可做或者有人在等并且用完了时间片再归还
+// 每个线程池低于自己的保证数量时总能拿到名额; 超出的部分从全局预算里借,
+// 某个池空闲时它的名额自然就借给了别的池
+class ExecutorGroup
+{
+public:
+    explicit ExecutorGroup(int budget = CpuQuota::defaultConcurrency());
+    ~ExecutorGroup();
+
+    ExecutorGroup(const ExecutorGroup &) = delete;
+    ExecutorGroup &operator=(const ExecutorGroup &) = delete;
+
+    // 创建一个加入本组的线程池, 返回的线程池还没有start
+    // minConcurrency: 这个池保证能同时执行的任务数量, 所有池的保证数量之和不能超过预算
+    ThreadPool &addPool(const std::string &name, int minConcurrency = 1);
+
+    // 按名字找线程池, 找不到抛std::out_of_range
+    ThreadPool &getPool(const std::string &name);
+
+    // 全局并发预算
+    int budget() const { return budget_; }
+
+    // 整个组正在执行的任务数量
+    int running();
+
+    // 某个池正在执行的任务数量
+    int running(const std::string &name);
+
+private:
+    friend class ThreadPoolBase;
+
+    // 工作线程执行任务前申请一个执行名额, 没有名额就阻塞
+    void acquire(ExecutorSlot *slot);
+
+    // 执行完归还名额
+    void release(ExecutorSlot *slot);
+
+    // 是否有工作线程在等名额, 不加锁
+    bool hasWaiters() const { return waiters_.load(std::memory_order_relaxed) > 0; }
+
+    ExecutorSlot *findSlot(const std::string &name);
+
+    // 名额空出来了, 叫醒一个能拿到名额的等待者, 调用方持有mutex_
+    void wakeOne(ExecutorSlot *released);
+
+private:
+    int budget_;   // 全局并发预算
+    int reserved_; // 所有池保证数量之和
+    int running_;  // 正在执行的任务数量
+    std::atomic_int waiters_; // 在等名额的工作线程数量
+    size_t nextWake_; // 轮流叫醒各个池的等待者
+
+    std::mutex mutex_;
+
+    // 放最后, 析构时先析构线程池, 这时mutex_还在
+    std::vector<std::unique_ptr<ExecutorSlot>> slots_;
+};
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef FIBER_H
+#define FIBER_H
+
+#include <vector>
+#include <deque>
+#include <queue>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+
+#include "threadpool.h"
+
+// 纤程(用户态线程), 用ucontext切换, 只支持linux
+// 在FiberPool的工作线程上多路复用, 阻塞写法的任务在纤程里等锁、等条件、睡眠时只切走纤程, 不占着系统线程
+struct Fiber;
+
+// 纤程栈池: mmap出来的栈, 最低一页设成不可访问当保护页, 栈溢出直接段错误而不是踩坏别的内存
+// 栈只占虚拟地址, 用到的页才有物理内存, 几万个纤程同时挂着也只要几个G的地址空间
+// 用完的栈留着下次用, 省掉mmap/munmap
+class FiberStackPool
+{
+public:
+    // stackSize: 每个栈可用的大小, 向上取整到页; maxCached: 最多缓存的空闲栈数量
+    explicit FiberStackPool(size_t stackSize = 64 * 1024, size_t maxCached = 1024);
+    ~FiberStackPool();
+
+    FiberStackPool(const FiberStackPool &) = delete;
+    FiberStackPool &operator=(const FiberStackPool &) = delete;
+
+    // 取一个栈, 返回可用部分的最低地址, 失败抛std::bad_alloc
+    void *allocate();
+
+    // 还回栈
+    void release(void *stack);
+
+    size_t stackSize() const { return stackSize_; }
+
+private:
+    size_t pageSize_;
+    size_t stackSize_;              // 可用部分大小
+    size_t maxCached_;
+    std::mutex mutex_;
+    std::vector<void *> free_;      // 空闲的栈
+};
+
+/*
+**********************************example**************************
+FiberPool pool;
+pool.start(4);
+FiberMutex mtx;
+FiberCondition cond;
+class LegacyTask : public Task {
+public:
+    Any run() override {
+        std::unique_lock<FiberMutex> lock(mtx);    // 等锁时切走纤程
+        cond.wait(lock, [] { return ready; });     // 等条件时切走纤程
+        FiberPool::sleepFor(std::chrono::milliseconds(10)); // 睡眠时切走纤程
+        return 0;
+    }
+};
+Result res = pool.submitTask(std::make_shared<LegacyTask>());
+*/
+
+// 纤程线程池: 每个任务跑在自己的纤程栈上, 工作线程轮流执行就绪的纤程
+class FiberPool
+{
+public:
+    // stackSize: 每个纤程的栈大小
+    explicit FiberPool(size_t stackSize = 64 * 1024);
+
+    // 等所有纤程执行完, 回收工作线程; 永远等不到唤醒的纤程会让析构卡住
+    ~FiberPool();
+
+    FiberPool(const FiberPool &) = delete;
+    FiberPool &operator=(const FiberPool &) = delete;
+
+    // 开启工作线程
+    void start(int threadSize = CpuQuota::defaultConcurrency());
+
+    // 提交任务, 任务在一个新纤程里执行
+    Result submitTask(std::shared_ptr<Task> sp);
+
+    // 还没执行完的纤程数量(就绪 + 挂起 + 正在执行)
+    size_t fiberSize() const { return fiberSize_; }
+
+    // 当前是不是在纤程里
+    static bool inFiber();
+
+    // 让出工作线程, 排到就绪队列末尾; 不在纤程里的话让出系统线程
+    static void yield();
+
+    // 睡眠, 期间工作线程执行别的纤程; 不在纤程里的话睡系统线程
+    static void sleepFor(std::chrono::nanoseconds duration);
+
+private:
+    friend class FiberMutex;
+    friend class FiberCondition;
+
+    using Clock = std::chrono::steady_clock;
+    using Timer = std::pair<Clock::time_point, Fiber *>;
+
+    // 工作线程函数
+    void workerFunc();
+
+    // 纤程入口
+    static void fiberEntry();
+
+    // 把挂起的纤程放回就绪队列
+    void schedule(Fiber *fiber);
+
+    // 挂起当前纤程, 切回工作线程; 切换完成后由工作线程解开release
+    // 调用方持有release, 并且已经把当前纤程登记到了能唤醒它的地方
+    static void suspend(std::mutex *release);
+
+    // 当前纤程, 不在纤程里返回nullptr
+    static Fiber *currentFiber();
+
+    FiberStackPool stacks_;
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;                    // 保护下面的队列和状态
+    std::condition_variable readyCond_;   // 有就绪的纤程, 或者要退出了
+    std::deque<Fiber *> ready_;           // 就绪队列
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_; // 睡眠中的纤程, 最早到期的在最前
+    bool isStopping_;
+
+    std::atomic_size_t fiberSize_;
+};
+
+// 纤程互斥锁, 等锁的纤程挂起, 不占工作线程
+// 满足BasicLockable, 可以配合std::unique_lock / std::lock_guard; 在纤程之外使用时自旋让出
+class FiberMutex
+{
+public:
+    FiberMutex() : locked_(false) {}
+
+    FiberMutex(const FiberMutex &) = delete;
+    FiberMutex &operator=(const FiberMutex &) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+private:
+    std::mutex guard_;             // 保护locked_和waiters_, 只在很短的时间里持有
+    bool locked_;
+    std::deque<Fiber *> waiters_;  // 等锁的纤程, 解锁时锁直接交给队头
+};
+
+// 纤程条件变量, 配合FiberMutex使用, 只能在纤程里等待
+class FiberCondition
+{
+public:
+    FiberCondition() = default;
+
+    FiberCondition(const FiberCondition &) = delete;
+    FiberCondition &operator=(const FiberCondition &) = delete;
+
+    void wait(std::unique_lock<FiberMutex> &lock);
+
+    template <typename Pred>
+    void wait(std::unique_lock<FiberMutex> &lock, Pred pred)
+    {
+        while (!pred())
+        {
+            wait(lock);
+        }
+    }
+
+    void notify_one();
+    void notify_all();
+
+private:
+    std::mutex guard_;
+    std::deque<Fiber *> waiters_;
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef HILL_CLIMBING_H
+#define HILL_CLIMBING_H
+
+/*
+**********************************example**************************
+ThreadPool pool;
+pool.setAutoTune(2, 32);    // 线程数在[2, 32]之间自动调整, 每500ms调一次
+pool.start(4);              // 从4个线程开始爬
+*/
+
+// 爬山法找吞吐量最高的线程数, 类似.NET线程池的hill climbing
+// 每个周期结束报告这个周期完成的任务吞吐量, 返回下一个周期的线程数, 每次改一个线程
+// 吞吐量变好: 沿原方向继续; 变差: 掉头; 变化在噪声以内: 多的线程没带来好处, 往少了走
+// 最后会在吞吐量开始不再增长的拐点附近来回一两个线程
+class HillClimber
+{
+public:
+    HillClimber(int minThreads, int maxThreads, int initThreads);
+
+    // 一个周期的吞吐量(任务数/秒), 返回下一个周期的线程数
+    int update(double throughput);
+
+    // 外部改了线程数(比如CPU配额变了), 从threads重新开始爬, 返回限制在上下限之内的线程数
+    int reset(int threads);
+
+    int current() const { return current_; }
+
+private:
+    int minThreads_;
+    int maxThreads_;
+    int current_;           // 当前线程数
+    int direction_;         // 上一步的方向, +1或-1
+    double lastThroughput_; // 上一个周期的吞吐量, 还没有时小于0
+};
+
+#endif
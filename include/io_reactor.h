@@ -0,0 +1,126 @@
+#ifndef IO_REACTOR_H
+#define IO_REACTOR_H
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+
+#include "threadpool.h"
+
+/*
+**********************************example**************************
+ThreadPool pool;
+pool.start(4);
+IoReactor &io = pool.reactor();
+io.asyncAccept(listenFd, [&](ssize_t fd) {
+    if (fd < 0) return;                          // -errno
+    io.asyncRead(fd, buf, sizeof(buf), [&, fd](ssize_t n) {
+        // 在线程池的工作线程上执行, n是读到的字节数或者-errno
+    });
+});
+*/
+
+// I/O反应器: 一个线程跑epoll, 线程池的工作线程不用阻塞在fd上
+// 发起的读写先直接尝试一次, 暂时做不了(EAGAIN)才登记到epoll, 就绪后由反应器线程完成系统调用
+// 完成后把回调投递回线程池执行, 回调参数: 成功是结果(字节数/新fd/0), 失败是-errno
+// 同一个fd同一方向上的操作按发起顺序完成; fd会被设置成非阻塞
+// 普通文件总是可读写, 操作直接完成, 不经过epoll
+// 关闭fd之前先cancel(fd), 还没完成的操作以-ECANCELED结束
+class IoReactor
+{
+public:
+    using IoCallback = std::function<void(ssize_t)>;
+
+    explicit IoReactor(ThreadPoolBase &pool);
+    ~IoReactor();
+
+    IoReactor(const IoReactor &) = delete;
+    IoReactor &operator=(const IoReactor &) = delete;
+
+    // 读最多len字节到buf, 完成前buf要一直有效
+    void asyncRead(int fd, void *buf, size_t len, IoCallback cb);
+
+    // 写最多len字节, 和write一样可能只写了一部分
+    void asyncWrite(int fd, const void *buf, size_t len, IoCallback cb);
+
+    // 在监听fd上接受一个连接, 新连接是非阻塞的
+    void asyncAccept(int fd, IoCallback cb);
+
+    // 只等fd可读/可写, 不做读写
+    void waitReadable(int fd, IoCallback cb);
+    void waitWritable(int fd, IoCallback cb);
+
+    // 取消fd上所有还没完成的操作
+    void cancel(int fd);
+
+    // 还没完成的操作数量
+    size_t pendingSize() const { return pendingSize_; }
+
+    // 停止反应器线程, 还没完成的操作以-ECANCELED结束; 析构时自动调用
+    void stop();
+
+private:
+    enum class OpType
+    {
+        READ,
+        WRITE,
+        ACCEPT,
+        READABLE,
+        WRITABLE,
+    };
+
+    struct IoOp
+    {
+        OpType type_;
+        void *buf_;
+        size_t len_;
+        IoCallback cb_;
+    };
+
+    // 一个fd上排队的操作, 读方向和写方向分开
+    struct FdState
+    {
+        std::deque<IoOp> readers_;
+        std::deque<IoOp> writers_;
+        uint32_t events_ = 0; // 已经登记到epoll的事件, 0表示没登记
+    };
+
+    using DoneOp = std::pair<IoOp, ssize_t>; // 完成的操作和结果
+
+    // 发起一个操作
+    void submitOp(int fd, IoOp op);
+
+    // 做一次系统调用, 暂时做不了返回false
+    static bool perform(int fd, IoOp &op, ssize_t &res);
+
+    // 按顺序完成队列里能完成的操作, 调用方持有mutex_
+    // ready: epoll刚报告这个方向就绪, 就绪等待可以完成
+    static void drain(int fd, std::deque<IoOp> &ops, bool ready, std::vector<DoneOp> &done);
+
+    // 按排队情况更新epoll登记的事件, 调用方持有mutex_
+    // 普通文件这类不能登记的fd, 把排队的操作直接完成
+    void updateInterest(int fd, FdState &state, std::vector<DoneOp> &done);
+
+    // 把回调投递回线程池
+    void complete(std::vector<DoneOp> &done);
+
+    // 反应器线程函数
+    void loop();
+
+    ThreadPoolBase &pool_;
+    int epollFd_;
+    int wakeFd_;                              // eventfd, stop()时叫醒epoll_wait
+    std::thread thread_;
+    std::atomic_bool isRunning_;
+
+    std::mutex mutex_;                        // 保护fds_
+    std::unordered_map<int, FdState> fds_;    // 有排队操作的fd
+    std::atomic_size_t pendingSize_;
+};
+
+#endif
@@ -0,0 +1,338 @@
+#ifndef PARALLEL_ALGORITHM_H
+#define PARALLEL_ALGORITHM_H
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <numeric>
+#include <iterator>
+
+#include "threadpool.h"
+
+// 基于线程池的并行算法, 都要求随机访问迭代器
+// 数据按块切分, 每块足够大(GRAIN个元素以上)才值得一个任务, 块内用标准库算法, 循环简单, 编译器容易向量化
+// 调用线程也执行一块; 在工作线程里调用时, 等待期间会帮忙执行其他任务, 不会卡死线程池
+// 提交失败(任务队列满)的块在调用线程上直接执行
+
+/*
+**********************************example**************************
+ThreadPool pool;
+pool.setTaskQueMaxThreshHold(64);
+pool.start(8);
+std::vector<int> v = ...;
+parallelSort(pool, v.begin(), v.end());
+parallelInclusiveScan(pool, v.begin(), v.end(), out.begin());
+long sum = parallelTransformReduce(pool, v.begin(), v.end(), 0L, std::plus<>(),
+                                   [](int x) { return (long)x * x; });
+*/
+
+// 每个任务至少处理的元素数量, 太小的话任务调度的开销比计算还大
+const size_t PARALLEL_GRAIN = 16 * 1024;
+
+// 把一个函数包成任务
+class ParallelChunkTask : public Task
+{
+public:
+    explicit ParallelChunkTask(std::function<void()> fn) : fn_(std::move(fn)) {}
+
+    Any run() override
+    {
+        fn_();
+        return 0;
+    }
+
+private:
+    std::function<void()> fn_;
+};
+
+// n个元素切成几块: 不小于grain, 块数不超过线程数的4倍(负载不均时能互相补)
+template <typename Pool>
+size_t parallelChunkCount(Pool &pool, size_t n, size_t grain = PARALLEL_GRAIN)
+{
+    size_t threads = std::max<size_t>(1, pool.threadSize());
+    size_t chunks = (n + grain - 1) / grain;
+    return std::max<size_t>(1, std::min(chunks, threads * 4));
+}
+
+// 第c块是[begin, end)
+inline size_t parallelChunkBegin(size_t n, size_t chunks, size_t c)
+{
+    return n / chunks * c + std::min(c, n % chunks);
+}
+
+// 并行执行fn(0) ... fn(chunks-1), 全部执行完才返回
+template <typename Pool, typename Fn>
+void parallelRunChunks(Pool &pool, size_t chunks, Fn &fn)
+{
+    if (chunks <= 1)
+    {
+        if (chunks == 1)
+        {
+            fn(0);
+        }
+        return;
+    }
+    std::vector<Result> results;
+    results.reserve(chunks - 1);
+    for (size_t c = 1; c < chunks; ++c)
+    {
+        results.emplace_back(pool.submitTask(std::make_shared<ParallelChunkTask>([&fn, c]()
+            {
+                fn(c);
+            })));
+    }
+    fn(0);
+    for (size_t c = 1; c < chunks; ++c)
+    {
+        Result &res = results[c - 1];
+        if (res.isValid())
+        {
+            res.get();
+        }
+        else
+        {
+            fn(c);
+        }
+    }
+}
+
+// **************************transform*****************************
+// d_first[i] = op(first[i])
+template <typename Pool, typename InputIt, typename OutputIt, typename UnaryOp>
+OutputIt parallelTransform(Pool &pool, InputIt first, InputIt last, OutputIt d_first, UnaryOp op)
+{
+    size_t n = std::distance(first, last);
+    size_t chunks = parallelChunkCount(pool, n);
+    auto fn = [&](size_t c)
+    {
+        size_t b = parallelChunkBegin(n, chunks, c);
+        size_t e = parallelChunkBegin(n, chunks, c + 1);
+        std::transform(first + b, first + e, d_first + b, op);
+    };
+    parallelRunChunks(pool, chunks, fn);
+    return d_first + n;
+}
+
+// **************************transform_reduce*****************************
+// reduce(init, transform(first[0]), transform(first[1]), ...), reduce要满足结合律
+// 每块先归约成一个值, 再按块的顺序归约, 结果和块的划分无关(浮点数除外)
+template <typename Pool, typename InputIt, typename T, typename BinaryOp, typename UnaryOp>
+T parallelTransformReduce(Pool &pool, InputIt first, InputIt last, T init, BinaryOp reduce, UnaryOp transform)
+{
+    size_t n = std::distance(first, last);
+    if (n == 0)
+    {
+        return init;
+    }
+    size_t chunks = parallelChunkCount(pool, n);
+    std::vector<T> partial(chunks);
+    auto fn = [&](size_t c)
+    {
+        size_t b = parallelChunkBegin(n, chunks, c);
+        size_t e = parallelChunkBegin(n, chunks, c + 1);
+        T acc = transform(first[b]);
+        for (size_t i = b + 1; i < e; ++i)
+        {
+            acc = reduce(std::move(acc), transform(first[i]));
+        }
+        partial[c] = std::move(acc);
+    };
+    parallelRunChunks(pool, chunks, fn);
+    for (T &value : partial)
+    {
+        init = reduce(std::move(init), std::move(value));
+    }
+    return init;
+}
+
+// **************************scan*****************************
+// 两遍: 第一遍每块求和, 块和做一次串行的前缀和得到每块的起点, 第二遍每块带着起点做扫描
+// 输入读两遍写一遍, 每块在一个线程上连续处理, 缓存友好
+template <typename Pool, typename InputIt, typename OutputIt, typename BinaryOp, typename T>
+OutputIt parallelScanImpl(Pool &pool, InputIt first, InputIt last, OutputIt d_first,
+    BinaryOp op, const T *init, bool inclusive)
+{
+    size_t n = std::distance(first, last);
+    if (n == 0)
+    {
+        return d_first;
+    }
+    size_t chunks = parallelChunkCount(pool, n);
+    std::vector<T> sums(chunks);
+
+    // 第一遍: 每块的和, 最后一块用不上
+    auto reduceChunk = [&](size_t c)
+    {
+        if (c + 1 == chunks)
+        {
+            return;
+        }
+        size_t b = parallelChunkBegin(n, chunks, c);
+        size_t e = parallelChunkBegin(n, chunks, c + 1);
+        T acc = first[b];
+        for (size_t i = b + 1; i < e; ++i)
+        {
+            acc = op(std::move(acc), first[i]);
+        }
+        sums[c] = std::move(acc);
+    };
+    parallelRunChunks(pool, chunks, reduceChunk);
+
+    // 每块的起点: 第c块之前所有元素的和(加上init)
+    std::vector<T> offsets(chunks);
+    std::vector<bool> hasOffset(chunks, false);
+    if (init != nullptr)
+    {
+        offsets[0] = *init;
+        hasOffset[0] = true;
+    }
+    for (size_t c = 1; c < chunks; ++c)
+    {
+        offsets[c] = hasOffset[c - 1] ? op(offsets[c - 1], sums[c - 1]) : sums[c - 1];
+        hasOffset[c] = true;
+    }
+
+    // 第二遍: 每块带着起点扫描
+    auto scanChunk = [&](size_t c)
+    {
+        size_t b = parallelChunkBegin(n, chunks, c);
+        size_t e = parallelChunkBegin(n, chunks, c + 1);
+        if (inclusive)
+        {
+            if (hasOffset[c])
+            {
+                std::inclusive_scan(first + b, first + e, d_first + b, op, offsets[c]);
+            }
+            else
+            {
+                std::inclusive_scan(first + b, first + e, d_first + b, op);
+            }
+        }
+        else
+        {
+            std::exclusive_scan(first + b, first + e, d_first + b, offsets[c], op);
+        }
+    };
+    parallelRunChunks(pool, chunks, scanChunk);
+    return d_first + n;
+}
+
+// d_first[i] = first[0] op ... op first[i]
+template <typename Pool, typename InputIt, typename OutputIt, typename BinaryOp = std::plus<>>
+OutputIt parallelInclusiveScan(Pool &pool, InputIt first, InputIt last, OutputIt d_first, BinaryOp op = BinaryOp())
+{
+    using T = typename std::iterator_traits<InputIt>::value_type;
+    return parallelScanImpl<Pool, InputIt, OutputIt, BinaryOp, T>(pool, first, last, d_first, op, nullptr, true);
+}
+
+// d_first[i] = init op first[0] op ... op first[i]
+template <typename Pool, typename InputIt, typename OutputIt, typename BinaryOp, typename T>
+OutputIt parallelInclusiveScan(Pool &pool, InputIt first, InputIt last, OutputIt d_first, BinaryOp op, T init)
+{
+    return parallelScanImpl(pool, first, last, d_first, op, &init, true);
+}
+
+// d_first[i] = init op first[0] op ... op first[i-1], d_first[0] = init
+template <typename Pool, typename InputIt, typename OutputIt, typename T, typename BinaryOp = std::plus<>>
+OutputIt parallelExclusiveScan(Pool &pool, InputIt first, InputIt last, OutputIt d_first, T init, BinaryOp op = BinaryOp())
+{
+    return parallelScanImpl(pool, first, last, d_first, op, &init, false);
+}
+
+// **************************sort*****************************
+// 有序的[a, aEnd)和[b, bEnd)合并到out, 输出很长时切成几段并行合并
+// 切分点: 在a上等距取点, 在b上lower_bound找对应位置; 相等的元素a里的在前, 和std::merge一样是稳定的
+template <typename Pool, typename It, typename OutIt, typename Compare>
+void parallelMerge(Pool &pool, It a, It aEnd, It b, It bEnd, OutIt out, Compare comp)
+{
+    size_t na = aEnd - a;
+    size_t nb = bEnd - b;
+    size_t pieces = std::min(parallelChunkCount(pool, na + nb), std::max<size_t>(1, na));
+    auto fn = [&](size_t p)
+    {
+        size_t aBegin = parallelChunkBegin(na, pieces, p);
+        size_t aStop = parallelChunkBegin(na, pieces, p + 1);
+        size_t bBegin = p == 0 ? 0 : std::lower_bound(b, bEnd, a[aBegin], comp) - b;
+        size_t bStop = p + 1 == pieces ? nb : std::lower_bound(b, bEnd, a[aStop], comp) - b;
+        std::merge(std::make_move_iterator(a + aBegin), std::make_move_iterator(a + aStop),
+            std::make_move_iterator(b + bBegin), std::make_move_iterator(b + bStop),
+            out + aBegin + bBegin, comp);
+    };
+    parallelRunChunks(pool, pieces, fn);
+}
+
+// 并行归并排序, 和std::sort一样不保证稳定
+// 每块先用std::sort排好(块不超过线程数的4倍, 每块能放进缓存的话更好), 再两两并行合并, 一共log2(块数)轮
+// 合并在原数组和一块同样大小的缓冲区之间来回, 元素类型要能默认构造
+template <typename Pool, typename RandomIt, typename Compare = std::less<>>
+void parallelSort(Pool &pool, RandomIt first, RandomIt last, Compare comp = Compare())
+{
+    using T = typename std::iterator_traits<RandomIt>::value_type;
+    size_t n = last - first;
+    size_t chunks = parallelChunkCount(pool, n);
+    if (chunks <= 1)
+    {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    auto sortChunk = [&](size_t c)
+    {
+        std::sort(first + parallelChunkBegin(n, chunks, c), first + parallelChunkBegin(n, chunks, c + 1), comp);
+    };
+    parallelRunChunks(pool, chunks, sortChunk);
+
+    // 有序段的边界, 每轮相邻两段合并成一段
+    std::vector<size_t> bounds;
+    for (size_t c = 0; c <= chunks; ++c)
+    {
+        bounds.push_back(parallelChunkBegin(n, chunks, c));
+    }
+    std::vector<T> buffer(n);
+    bool inBuffer = false;
+    while (bounds.size() > 2)
+    {
+        size_t runs = bounds.size() - 1;
+        size_t pairs = (runs + 1) / 2;
+        auto mergePair = [&](size_t p)
+        {
+            size_t lo = bounds[2 * p];
+            size_t mid = bounds[std::min(2 * p + 1, runs)];
+            size_t hi = bounds[std::min(2 * p + 2, runs)];
+            if (inBuffer)
+            {
+                parallelMerge(pool, buffer.begin() + lo, buffer.begin() + mid,
+                    buffer.begin() + mid, buffer.begin() + hi, first + lo, comp);
+            }
+            else
+            {
+                parallelMerge(pool, first + lo, first + mid, first + mid, first + hi, buffer.begin() + lo, comp);
+            }
+        };
+        // 段少的时候每对内部再切分并行合并, 段多的时候各对之间已经够并行了
+        parallelRunChunks(pool, pairs, mergePair);
+
+        std::vector<size_t> next;
+        for (size_t i = 0; i < bounds.size(); i += 2)
+        {
+            next.push_back(bounds[i]);
+        }
+        if (next.back() != n)
+        {
+            next.push_back(n);
+        }
+        bounds.swap(next);
+        inBuffer = !inBuffer;
+    }
+
+    if (inBuffer)
+    {
+        parallelTransform(pool, buffer.begin(), buffer.end(), first, [](T &value) -> T
+            {
+                return std::move(value);
+            });
+    }
+}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+#include "threadpool.h"
+
+/*
+**********************************example**************************
+ThreadPool pool;
+pool.start(4);
+Pipeline pipe;
+pipe.setSource([&](Any &out) -> bool {          // 串行读取, 返回false表示读完了
+    if (!readChunk(buf)) return false;
+    out = std::make_shared<Chunk>(buf);
+    return true;
+});
+pipe.addStage(StageMode::PARALLEL, [](Any in) -> Any {
+    return parse(in.cast_<std::shared_ptr<Chunk>>());
+});
+pipe.addStage(StageMode::SERIAL_IN_ORDER, [&](Any in) -> Any {
+    write(in.cast_<std::shared_ptr<Record>>());  // 按读取顺序写出
+    return 0;
+});
+pipe.run(pool, 16);                              // 最多16个数据同时在流水线里
+*/
+
+// 阶段的执行方式
+enum class StageMode
+{
+    SERIAL_IN_ORDER,     // 同一时间只处理一个, 按源头产生的顺序
+    SERIAL_OUT_OF_ORDER, // 同一时间只处理一个, 先到先处理
+    PARALLEL,            // 不限制并发
+};
+
+// 多阶段流水线: 源头(串行) -> 阶段1 -> 阶段2 -> ...
+// 每个数据在一个任务里一口气往下走, 碰到忙着的串行阶段就留在这个阶段的缓冲里, 任务去源头取下一个
+// 串行阶段处理完一个, 把缓冲里轮到的那个交给新任务(工作线程里提交, 进本地队列, 不经过全局taskQue_)
+// 同时在流水线里的数据(包括在缓冲里等的)不超过maxTokens个, 内存有上限
+// 阶段抛出异常时源头停止, 已经在流水线里的数据跳过剩下的阶段, run()重新抛出第一个异常
+class Pipeline
+{
+public:
+    using SourceFunc = std::function<bool(Any &)>;
+    using StageFunc = std::function<Any(Any)>;
+
+    Pipeline();
+    ~Pipeline() = default;
+
+    Pipeline(const Pipeline &) = delete;
+    Pipeline &operator=(const Pipeline &) = delete;
+
+    // 源头, 串行调用; 产生一个数据返回true, 没有了返回false
+    void setSource(SourceFunc source);
+
+    // 在末尾加一个阶段
+    void addStage(StageMode mode, StageFunc fn);
+
+    size_t stageSize() const { return stages_.size(); }
+
+    // 跑完整个流水线才返回, 可以重复run
+    // 在工作线程里调用时按blocking_scope处理, 线程池会补偿一个线程
+    template <typename Pool>
+    void run(Pool &pool, size_t maxTokens)
+    {
+        submit_ = [&pool](std::shared_ptr<Task> task)
+        {
+            return pool.submitTask(task).isValid();
+        };
+        runImpl(maxTokens);
+    }
+
+private:
+    friend class PipelineTask;
+
+    // 流水线里的一个数据
+    struct Item
+    {
+        Any value_;
+        size_t seq_ = 0;          // 源头产生的序号
+        size_t stage_ = 0;        // 下一个要进的阶段
+        bool ownsStage_ = false;  // 已经占住了stage_这个串行阶段
+        bool failed_ = false;     // 前面的阶段抛了异常, 剩下的阶段只走过场
+    };
+
+    struct Stage
+    {
+        StageMode mode_;
+        StageFunc fn_;
+        std::mutex mutex_;                 // 保护下面的成员
+        bool busy_ = false;                // 串行阶段正在处理一个数据
+        size_t nextSeq_ = 0;               // 按序阶段下一个该处理的序号
+        std::map<size_t, Item> ordered_;   // 按序阶段的缓冲, 按序号排
+        std::deque<Item> unordered_;       // 不按序阶段的缓冲
+    };
+
+    void runImpl(size_t maxTokens);
+
+    // 任务函数: 先把带来的数据往下走, 再不停地从源头取
+    void work(Item *item);
+
+    // 从源头取一个数据, 取不到(源头忙/令牌用完/读完了)返回false
+    bool fetch(Item &item);
+
+    // 数据从item.stage_开始往下走, 停在某个串行阶段的缓冲里或者走完
+    void advance(Item item);
+
+    // 提交一个任务, 带着item(可以为nullptr)
+    void spawn(Item *item);
+
+    void setError(std::exception_ptr error);
+
+    // 任务结束, 最后一个结束时叫醒run()
+    void taskExit();
+
+    SourceFunc source_;
+    std::vector<std::unique_ptr<Stage>> stages_;
+    std::function<bool(std::shared_ptr<Task>)> submit_;
+
+    std::mutex sourceMutex_;           // 源头串行
+    size_t sourceSeq_;                 // 下一个数据的序号
+    std::atomic_bool sourceDone_;      // 源头已经没有数据了
+    size_t maxTokens_;
+    std::atomic_size_t inFlight_;      // 在流水线里的数据数量
+
+    std::mutex doneMutex_;             // 保护下面的成员
+    std::condition_variable doneCond_;
+    int liveTasks_;                    // 还没结束的任务数量, 归零时流水线跑完
+    std::exception_ptr error_;         // 第一个异常
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef POLLING_POOL_H
+#define POLLING_POOL_H
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+
+#include "threadpool.h"
+
+// 单生产者单消费者的任务通道, 固定容量的环形缓冲区
+// 只能由绑定它的那一个生产者线程提交任务, 由一个轮询线程取任务
+class PollingLane
+{
+public:
+    // 提交任务, 不加锁不进内核, 通道满了马上返回无效的Result
+    Result submitTask(std::shared_ptr<Task> sp);
+
+    // 通道里还没被取走的任务数量, 只是个估计值
+    size_t size() const;
+
+    PollingLane(const PollingLane &) = delete;
+    PollingLane &operator=(const PollingLane &) = delete;
+
+private:
+    friend class PollingPool;
+
+    explicit PollingLane(size_t capacity);
+
+    // 轮询线程取一个任务, 没有的话返回nullptr
+    std::shared_ptr<Task> pop();
+
+    std::vector<std::shared_ptr<Task>> slots_;
+    size_t mask_;                              // 容量-1, 容量是2的幂
+
+    // 生产者和消费者各写各的, 分开放在不同的缓存行上
+    alignas(64) std::atomic<size_t> tail_;     // 生产者写的位置
+    size_t headCache_;                         // 生产者看到的消费位置, 追上了才重新读head_
+    alignas(64) std::atomic<size_t> head_;     // 消费者读的位置
+    size_t tailCache_;                         // 消费者看到的生产位置
+};
+
+/*
+**********************************example**************************
+PollingPool pool(2, {2, 3});              // 2个轮询线程, 绑到隔离出来的2号、3号核
+PollingLane &feed = pool.addLane();       // 每个行情线程一个通道
+pool.start();
+// 行情线程里
+feed.submitTask(std::make_shared<QuoteTask>(quote));
+*/
+
+// 轮询线程池: 工作线程从不睡眠, 一直轮询分给自己的通道
+// 提交到开始执行只有几次缓存行传递, 没有锁、条件变量和内核唤醒, 代价是每个工作线程占满一个核
+// 适合少量延迟敏感的生产者; 普通任务还是用ThreadPool
+// 任务里不要阻塞, 也不要在任务里等别的任务的Result
+class PollingPool
+{
+public:
+    // workers: 轮询线程数量; cpus: 轮询线程依次绑定的cpu, 空的话不绑
+    explicit PollingPool(int workers = 1, std::vector<int> cpus = std::vector<int>());
+    ~PollingPool();
+
+    PollingPool(const PollingPool &) = delete;
+    PollingPool &operator=(const PollingPool &) = delete;
+
+    // 添加一个通道, 只能在start()之前调用, 通道按添加顺序轮流分给轮询线程
+    // capacity向上取到2的幂
+    PollingLane &addLane(size_t capacity = 1024);
+
+    // 启动轮询线程
+    void start();
+
+    // 停止轮询, 通道里剩下的任务执行完再退出, 析构时自动调用
+    // 之后再提交的任务不会执行
+    void stop();
+
+private:
+    // 轮询线程函数, 轮询lanes里的所有通道
+    void pollFunc(int index, std::vector<PollingLane *> lanes);
+
+    int workerSize_;                                // 轮询线程数量
+    std::vector<int> cpus_;                         // 绑定的cpu
+    std::vector<std::unique_ptr<PollingLane>> lanes_;
+    std::vector<std::thread> workers_;
+    std::atomic_bool isRunning_;                    // 轮询线程是否继续轮询
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+**********************************example**************************
+ThreadPool pool;
+pool.start(8);
+pool.startRecording("workload.bin");    // 之后提交的任务都记下来
+auto task = std::make_shared<MyTask>();
+task->setTag(REQUEST_KIND_QUERY);       // 调用方自己定义的分类
+pool.submitTask(task);
+...
+pool.stopRecording();
+// 离线: workload_replay workload.bin 4     用4个线程的线程池重放, 看排队时间和利用率
+*/
+
+// 一个任务的记录, 文件里按这个布局紧挨着存
+struct WorkloadRecord
+{
+    uint64_t submitNs_; // 提交时刻, 从开始记录算起
+    uint64_t runNs_;    // 执行耗时
+    uint32_t thread_;   // 提交线程的编号, 同一个线程在一次记录里编号不变
+    uint32_t tag_;      // 调用方给的标签
+};
+static_assert(sizeof(WorkloadRecord) == 24, "WorkloadRecord must stay packed");
+
+// 负载记录器: 任务执行完时追加一条记录到本线程的缓冲区, 攒够一批再写文件, stop()时写完所有线程剩下的
+// 文件里按线程分批存, 不是按时间顺序
+// 文件格式: 头部(魔数"TPWR", 版本, 每条记录的字节数) + 若干条WorkloadRecord, 本机字节序
+class WorkloadRecorder
+{
+public:
+    WorkloadRecorder();
+    ~WorkloadRecorder();
+
+    WorkloadRecorder(const WorkloadRecorder &) = delete;
+    WorkloadRecorder &operator=(const WorkloadRecorder &) = delete;
+
+    // 打开文件开始记录, 已经在记录的话先结束上一次; 打不开返回false
+    bool start(const std::string &path);
+
+    // 写完缓冲区, 关闭文件; 开始记录前提交、结束后才执行完的任务不记
+    void stop();
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // 提交时刻, 写进任务里, 执行完时连同耗时交给record
+    int64_t submitStamp() const { return nowNs(); }
+
+    // 记一个执行完的任务
+    void record(int64_t submitNs, uint32_t thread, int64_t runNs, uint32_t tag);
+
+    // 这次写进文件的任务数, 各线程缓冲区里还没写的不算, stop()之后是准确的
+    size_t recorded() const { return recorded_; }
+
+    // 当前线程的编号, 从1开始, 每个线程第一次调用时分配
+    static uint32_t threadIndex();
+
+    static int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // 读出一个记录文件, 格式不对返回false
+    static bool load(const std::string &path, std::vector<WorkloadRecord> &records);
+
+private:
+    struct ThreadBuffer;
+
+    // 当前线程在这次记录里的缓冲区, 第一次调用时创建; 已经结束记录返回nullptr
+    ThreadBuffer *threadBuffer(uint64_t generation);
+
+    // 把一个线程的缓冲区写进文件, 调用方持有buffer->mutex_
+    void flush(ThreadBuffer *buffer);
+
+    std::atomic_bool enabled_;
+    std::atomic<int64_t> startNs_;        // 开始记录的时刻
+    std::atomic<uint64_t> generation_;    // 每次start()换一个全局唯一的编号, 线程据此认出自己的缓冲区
+    std::mutex controlMutex_;             // start()和stop()互斥
+    std::mutex mutex_;                    // 保护下面的成员; 和ThreadBuffer::mutex_一起拿时先拿后者
+    std::ofstream file_;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers_; // 这次记录所有线程的缓冲区
+    std::atomic<size_t> recorded_;
+};
+
+#endif
@@ -0,0 +1,329 @@
+#ifndef SHM_QUEUE_H
+#define SHM_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <thread>
+
+class Task;
+
+/*
+**********************************example**************************
+// 线程池进程
+auto que = ShmQueue::create("/tp_shm", ShmQueueOptions());
+ShmTaskServer server(*que, [](ShmRequest &req) -> int32_t
+    {
+        // req.data_里是请求, 结果原地写回, 最多req.capacity_字节
+        req.resultSize_ = compute(req.type_, req.data_, req.size_);
+        return 0;
+    });
+server.start(pool);                       // 和进程内提交的任务一起在pool上执行
+...
+server.stop();
+
+// 其他进程
+auto que = ShmQueue::open("/tp_shm");
+que->submit(clientId, requestId, TYPE_HASH, buf, len);   // 没有空闲数据块时返回false
+ShmCompletion done;
+que->waitComplete(clientId, done, std::chrono::milliseconds(100));
+use(que->data(done.offset_), done.size_);
+que->release(done.offset_);              // 数据块还回去, 偏移不对或者重复归还返回false
+*/
+
+// 共享内存里的任务描述符, 固定大小, 负载放在数据区里
+struct ShmTaskDesc
+{
+    uint64_t id_;       // 提交方自己定的编号, 原样带回完成记录
+    uint64_t offset_;   // 负载在映射里的偏移
+    uint32_t size_;     // 负载长度
+    uint32_t type_;     // 任务类型, 服务端按这个分发
+    uint32_t client_;   // 提交方编号, 结果写回它的完成环
+    uint32_t reserved_;
+};
+static_assert(sizeof(ShmTaskDesc) == 32, "ShmTaskDesc must stay packed");
+
+// 完成记录, 结果写在请求用的同一个数据块里
+struct ShmCompletion
+{
+    uint64_t id_;       // 请求的编号
+    uint64_t offset_;   // 结果在映射里的偏移
+    uint32_t size_;     // 结果长度
+    int32_t status_;    // 处理函数的返回值, 小于0表示失败
+};
+static_assert(sizeof(ShmCompletion) == 24, "ShmCompletion must stay packed");
+
+struct ShmQueueOptions
+{
+    uint32_t blocks_ = 1024;      // 数据块数量, 也就是同时在途的请求数量上限, 向上取2的幂
+    uint32_t blockSize_ = 4096;   // 每个数据块的字节数, 请求和结果都不能超过
+    uint32_t clients_ = 8;        // 提交方数量, 每个提交方一个完成环
+};
+
+// 共享内存里的有界无锁环, 多生产者多消费者(Vyukov的按槽位序号算法)
+// 环本身放在映射里, 这个类只是个视图, 两个进程各自构造一个指向同一块内存
+// 容量必须是2的幂
+template <typename T>
+class ShmRing
+{
+public:
+    ShmRing() : header_(nullptr), cells_(nullptr), mask_(0) {}
+
+    // 环占用的字节数
+    static size_t bytes(uint32_t capacity) { return sizeof(Header) + capacity * sizeof(Cell); }
+
+    // 在base上初始化一个空环, 只由创建方调用一次
+    static void init(void *base, uint32_t capacity)
+    {
+        Header *header = new (base) Header();
+        Cell *cells = reinterpret_cast<Cell *>(header + 1);
+        for (uint32_t i = 0; i < capacity; ++i)
+        {
+            new (&cells[i]) Cell();
+            cells[i].seq_.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ShmRing(void *base, uint32_t capacity)
+        : header_(static_cast<Header *>(base))
+        , cells_(reinterpret_cast<Cell *>(header_ + 1))
+        , mask_(capacity - 1)
+    {}
+
+    // 满了返回false
+    bool tryPush(const T &value)
+    {
+        uint64_t pos = header_->tail_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell &cell = cells_[pos & mask_];
+            uint64_t seq = cell.seq_.load(std::memory_order_acquire);
+            int64_t diff = (int64_t)seq - (int64_t)pos;
+            if (diff == 0)
+            {
+                if (header_->tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.value_ = value;
+                    cell.seq_.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = header_->tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // 空了返回false
+    bool tryPop(T &value)
+    {
+        uint64_t pos = header_->head_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell &cell = cells_[pos & mask_];
+            uint64_t seq = cell.seq_.load(std::memory_order_acquire);
+            int64_t diff = (int64_t)seq - (int64_t)(pos + 1);
+            if (diff == 0)
+            {
+                if (header_->head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = cell.value_;
+                    cell.seq_.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = header_->head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // 等待用的字, 生产者推进去以后加1, 配合futex睡眠/唤醒
+    std::atomic<uint32_t> &signal() { return header_->signal_; }
+    std::atomic<uint32_t> &waiters() { return header_->waiters_; }
+
+private:
+    // 头尾各占一个缓存行, 生产者和消费者不互相踩
+    struct Header
+    {
+        alignas(64) std::atomic<uint64_t> tail_{0};
+        alignas(64) std::atomic<uint64_t> head_{0};
+        alignas(64) std::atomic<uint32_t> signal_{0};
+        std::atomic<uint32_t> waiters_{0};
+    };
+
+    struct Cell
+    {
+        std::atomic<uint64_t> seq_{0};
+        T value_{};
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory ring needs lock-free 64-bit atomics");
+
+    Header *header_;
+    Cell *cells_;
+    uint64_t mask_;
+};
+
+// 跨进程的任务队列: 一块共享内存映射, 里面有
+// 提交环(任务描述符) + 空闲数据块环 + 每个提交方一个完成环 + 每个数据块一个状态字节 + 数据区
+// 提交方从空闲环拿一个数据块写请求, 描述符推进提交环; 线程池进程执行完把结果写回同一个数据块,
+// 完成记录推进提交方的完成环; 提交方读完结果把数据块还回空闲环
+// 有名字的用shm_open, 其他进程按名字打开; 名字为空用memfd_create, fork出来的子进程或者收到fd的进程用openFd打开
+// 没有处理提交方进程崩溃: 它拿着的数据块不会回到空闲环
+class ShmQueue
+{
+public:
+    // 创建并初始化, 失败返回nullptr; 有名字的在析构时shm_unlink
+    static std::unique_ptr<ShmQueue> create(const std::string &name, const ShmQueueOptions &options);
+
+    // 打开别的进程创建的队列, 失败返回nullptr
+    static std::unique_ptr<ShmQueue> open(const std::string &name);
+
+    // 用memfd/shm的fd打开, 成功后fd归返回的对象管, 析构时关闭
+    static std::unique_ptr<ShmQueue> openFd(int fd);
+
+    ~ShmQueue();
+
+    ShmQueue(const ShmQueue &) = delete;
+    ShmQueue &operator=(const ShmQueue &) = delete;
+
+    int fd() const { return fd_; }
+    uint32_t blockSize() const;
+    uint32_t clients() const;
+
+    // 映射里offset处的数据
+    char *data(uint64_t offset) { return base_ + offset; }
+
+    // ---------------- 提交方 ----------------
+    // 拷贝负载进一个空闲数据块并提交, 没有空闲数据块或者负载太大返回false
+    bool submit(uint32_t client, uint64_t id, uint32_t type, const void *data, uint32_t size);
+
+    // 取一条完成记录, 没有返回false
+    bool tryComplete(uint32_t client, ShmCompletion &completion);
+
+    // 等一条完成记录, 超时返回false
+    bool waitComplete(uint32_t client, ShmCompletion &completion, std::chrono::milliseconds timeout);
+
+    // 读完结果后把数据块还回去; 不是数据块的起始偏移, 或者数据块已经在空闲环里, 不还并返回false
+    bool release(uint64_t offset);
+
+    // ---------------- 线程池进程 ----------------
+    bool tryTake(ShmTaskDesc &desc);
+
+    // 等一个任务描述符, 超时或者被wakeTakers叫醒返回false
+    bool waitTake(ShmTaskDesc &desc, std::chrono::milliseconds timeout);
+
+    // 叫醒在waitTake里睡着的线程
+    void wakeTakers();
+
+    // 描述符是不是指向一个已经被提交方拿走的完整数据块, 提交方编号在范围内
+    bool isValid(const ShmTaskDesc &desc) const;
+
+    // 结果已经写进desc的数据块, 推一条完成记录给提交方
+    void complete(const ShmTaskDesc &desc, int32_t status, uint32_t size);
+
+private:
+    struct Layout;
+
+    ShmQueue(int fd, char *base, size_t size, std::string name, bool owner);
+
+    // 按映射头部的参数建好各个环的视图
+    void attach();
+
+    // offset是不是某个数据块的起始偏移
+    bool isBlock(uint64_t offset) const;
+
+    // offset处数据块的状态, 1表示在空闲环里, 0表示被提交方拿走了; 调用方先用isBlock检查
+    std::atomic<uint8_t> &blockState(uint64_t offset) const;
+
+    int fd_;
+    char *base_;
+    size_t size_;
+    std::string name_;      // shm_open的名字, memfd为空
+    bool owner_;            // 创建方析构时删除名字
+
+    ShmRing<ShmTaskDesc> submitRing_;
+    ShmRing<uint64_t> freeRing_;         // 空闲数据块的偏移
+    std::unique_ptr<ShmRing<ShmCompletion>[]> completionRings_;
+};
+
+// 处理函数看到的一个请求, 结果原地写回data_
+struct ShmRequest
+{
+    uint32_t type_;
+    char *data_;
+    uint32_t size_;         // 请求长度
+    uint32_t capacity_;     // 数据块大小, 结果不能超过
+    uint32_t resultSize_;   // 处理函数填写结果长度, 默认0
+};
+
+// 把共享内存队列接到线程池上: 一个搬运线程从提交环取描述符, 包成任务提交给线程池,
+// 和进程内提交的任务一起排队执行; 处理函数的返回值作为完成记录的状态, 抛异常记为-1
+// 线程池的任务队列满了, 搬运线程退避着重试手上那一个, 不再取新的: 描述符留在提交环里, 数据块用完后提交方的submit返回false
+class ShmTaskServer
+{
+public:
+    using Handler = std::function<int32_t(ShmRequest &)>;
+
+    ShmTaskServer(ShmQueue &queue, Handler handler);
+    ~ShmTaskServer();
+
+    ShmTaskServer(const ShmTaskServer &) = delete;
+    ShmTaskServer &operator=(const ShmTaskServer &) = delete;
+
+    // 开始搬运, 线程池要比stop()活得久
+    template <typename Pool>
+    void start(Pool &pool)
+    {
+        submit_ = [&pool](std::shared_ptr<Task> task)
+        {
+            return pool.trySubmitTask(task).isValid();
+        };
+        startImpl();
+    }
+
+    // 停止搬运, 等已经交给线程池的任务执行完
+    void stop();
+
+    // 执行完的请求数量
+    uint64_t served() const { return served_; }
+
+private:
+    friend class ShmTask;
+
+    void startImpl();
+    void pumpLoop();
+
+    // 在工作线程上执行一个请求, 推完成记录
+    void serve(const ShmTaskDesc &desc);
+
+    ShmQueue &queue_;
+    Handler handler_;
+    std::function<bool(std::shared_ptr<Task>)> submit_;
+    std::thread pumpThread_;
+    std::atomic_bool stop_;
+    std::atomic<uint64_t> served_;
+
+    std::mutex inFlightMutex_;
+    std::condition_variable inFlightCond_;
+    size_t inFlight_;                   // 交给线程池还没执行完的请求, inFlightMutex_保护
+};
+
+#endif
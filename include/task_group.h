@@ -0,0 +1,136 @@
+#ifndef TASK_GROUP_H
+#define TASK_GROUP_H
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+#include "threadpool.h"
+
+/*
+**********************************example**************************
+ThreadPool pool;
+pool.start(16);
+TaskGroup tenantA(pool, 4);               // 这一组最多同时占4个工作线程
+for (auto &req : batch)
+{
+    tenantA.run(std::make_shared<ReqTask>(req));  // 超出的任务停在组里, 不进全局队列
+}
+tenantA.wait();                           // 只等这一批, 有任务抛异常的话这里重新抛出第一个
+
+tenantB.cancel();                         // 组里还没开始的任务不再执行, 正在执行的自己检查isCancelled()
+*/
+
+class GroupTask;
+
+// 任务组: 一批任务共用一个并发上限, 可以只等这一批执行完, 可以整批取消
+// 没超过上限的任务直接提交给线程池; 超过的停在组里的队列, 组里有任务执行完才交给线程池,
+// 不占线程池队列的名额, 也不挡别的组的任务
+// 组里的任务通过组执行, 结果不经过Result, 需要的话写在任务对象里
+// 任务抛出的异常不会传给线程池: 记下第一个, 取消整组, wait()时重新抛出
+// 交给线程池的任务带着组的CancellationToken, 取消时还在排队的马上让出线程池队列的名额
+// 线程池不收的任务(队列满了或者已经停了)不等空位, 在提交的线程上直接执行
+class TaskGroup
+{
+public:
+    // maxConcurrency: 同时在线程池里(排队+执行)的任务数量上限, 0表示不限制
+    template <typename Pool>
+    explicit TaskGroup(Pool &pool, int maxConcurrency = 0)
+        : TaskGroup(maxConcurrency)
+    {
+        submit_ = [&pool](std::shared_ptr<Task> task, CancellationToken token)
+        {
+            return pool.trySubmitTask(std::move(task), std::move(token));
+        };
+    }
+
+    // 等组里的任务都结束, 异常丢掉
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    // 加一个任务; 组已经取消的话直接丢掉
+    void run(std::shared_ptr<Task> task);
+
+    // 等到组里的任务都结束(取消的不算), 之后组可以继续用
+    // 全部正常执行完返回true, 被取消过返回false; 有任务抛了异常则重新抛出第一个
+    // 在工作线程里调用时按blocking_scope处理, 线程池会补偿一个线程
+    bool wait();
+
+    // 取消: 停在组里的任务直接丢掉, 已经交给线程池还没开始的从线程池队列里撤回, 正在执行的自己检查isCancelled()
+    // 取消状态保持到wait()返回
+    void cancel();
+
+    bool isCancelled() const;
+
+    // 调整并发上限, 调大时马上放出停着的任务
+    void setMaxConcurrency(int maxConcurrency);
+
+    // 还没结束的任务数量(停在组里的 + 交给线程池的)
+    size_t pending() const;
+
+private:
+    friend class GroupTask;
+
+    // 一个任务结束以后要接着做的事
+    struct Followup
+    {
+        std::shared_ptr<GroupTask> next_;                        // 接替名额的停着的任务
+        bool cancel_ = false;                                    // 任务抛了异常, 要撤回交给线程池的任务
+        CancellationToken token_ = CancellationToken::none();   // 要取消的token
+    };
+
+    explicit TaskGroup(int maxConcurrency);
+
+    // 交给线程池, 线程池不收就在当前线程执行, 接替名额的停着的任务在循环里接着提交, 不递归
+    // 调用方已经为这个任务占了一个busy_, 最后一次碰组的时候还掉
+    void submit(std::shared_ptr<GroupTask> task);
+
+    // 线程池上执行完组里的一个任务, 换一个停着的任务进线程池
+    void taskDone(GroupTask *task, std::exception_ptr error);
+
+    // 任务结束的记账; 有后续要做的话在同一个锁里占一个busy_, 返回true
+    bool finish(GroupTask *task, std::exception_ptr error, Followup &followup);
+
+    // 还掉一个busy_, 这是最后一次碰组: 之后wait()或析构可能马上返回
+    void leave();
+
+    // 还掉一个busy_, 调用方持有mutex_
+    void leaveLocked();
+
+    // 没有没结束的任务, 也没有线程还要碰组, wait()和析构等的就是这个; 调用方持有mutex_
+    bool idle() const { return pending_ == 0 && busy_ == 0; }
+
+    // 任务结束的记账, 执行完和被token撤回的只算一次; 调用方持有mutex_
+    // 已经算过返回false
+    bool settle(GroupTask *task);
+
+    // 被token撤回的任务从线程池里收回来, 调用方持有mutex_
+    // 撤回的任务的Result放进dropped, 由调用方在锁外面析构
+    void collectCancelled(std::vector<Result> &dropped);
+
+    // 取消token, 收回被撤回的任务
+    void cancelSubmitted(CancellationToken token);
+
+    std::function<Result(std::shared_ptr<Task>, CancellationToken)> submit_;
+
+    mutable std::mutex mutex_;                 // 保护下面的成员
+    std::condition_variable doneCond_;
+    int maxConcurrency_;
+    size_t active_;                            // 交给了线程池还没结束的
+    size_t pending_;                           // active_ + 停着的
+    size_t busy_;                              // 任务交出去以后还要碰组的线程(提交、换下一个、撤回), 归零之前组不能销毁
+    std::deque<std::shared_ptr<GroupTask>> parked_; // 超过上限停在组里的任务
+    std::unordered_map<GroupTask *, Result> inFlight_; // 交给线程池还没结束的任务, 取消时靠Result看出哪些被撤回了
+    CancellationToken token_;                  // 交给线程池的任务都带着它, wait()以后换一个新的
+    bool cancelled_;
+    std::exception_ptr error_;                 // 第一个异常
+};
+
+#endif
@@ -10,7 +10,24 @@
 #include <stdexcept>
 #include <functional>
 #include <unordered_map>
+#include <deque>
 #include <thread>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+#include "tracer.h"
+#include "codel.h"
+#include "recorder.h"
+#include "hill_climbing.h"
+#include "cpu_quota.h"
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#endif
 
 // any类型
 class Any
@@ -73,10 +90,12 @@ private:
 };
 
 // 实现信号量
+// 计数用原子变量维护, 只有真正有线程在等待时才进入内核(futex)
+// post()在没有等待者时只是一次原子加, 不加锁也不notify
 class Semaphore
 {
 public:
-    Semaphore(int limit = 0) : resLimit(limit)
+    Semaphore(int limit = 0) : resLimit_(limit), waiters_(0)
     {
         if (limit < 0)
         {
@@ -85,26 +104,263 @@ public:
     }
     ~Semaphore() = default;
 
+    Semaphore(const Semaphore &) = delete;
+    Semaphore &operator=(const Semaphore &) = delete;
+
     void wait()
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        // 等待直到信号量计数大于0
-        cond_.wait(lock, [&]() -> bool
-                   { return resLimit > 0; });
-        --resLimit; // 减少信号量计数
+        // 快速路径: 计数大于0直接拿走, 不进内核
+        if (try_wait())
+        {
+            return;
+        }
+        waiters_.fetch_add(1); // 先登记等待者, 再检查计数, 和post()里的顺序相反
+        while (!try_wait())
+        {
+            futexWait(nullptr);
+        }
+        waiters_.fetch_sub(1);
+    }
+
+    // 不阻塞, 拿到计数返回true
+    bool try_wait()
+    {
+        int cur = resLimit_.load();
+        while (cur > 0)
+        {
+            if (resLimit_.compare_exchange_weak(cur, cur - 1))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 最多等待timeout, 超时返回false
+    template <typename Rep, typename Period>
+    bool wait_for(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        if (try_wait())
+        {
+            return true;
+        }
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        waiters_.fetch_add(1);
+        bool ok = false;
+        for (;;)
+        {
+            if (try_wait())
+            {
+                ok = true;
+                break;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (now >= deadline)
+            {
+                break;
+            }
+            auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now);
+            futexWait(&left);
+        }
+        waiters_.fetch_sub(1);
+        // 超时离开时可能"吃掉"了一次唤醒, 转交给其他等待者
+        if (!ok && resLimit_.load() > 0 && waiters_.load() > 0)
+        {
+            futexWake();
+        }
+        return ok;
     }
 
     void post()
     {
+        ++resLimit_; // 增加信号量计数
+        if (waiters_.load() > 0)
+        {
+            futexWake(); // 有等待者才唤醒一个
+        }
+    }
+
+private:
+    // 计数为0时睡眠, 计数在睡眠前已经变化则立即返回
+    void futexWait(const std::chrono::nanoseconds *timeout)
+    {
+#ifdef __linux__
+        struct timespec ts;
+        struct timespec *pts = nullptr;
+        if (timeout != nullptr)
+        {
+            ts.tv_sec = static_cast<time_t>(timeout->count() / 1000000000);
+            ts.tv_nsec = static_cast<long>(timeout->count() % 1000000000);
+            pts = &ts;
+        }
+        syscall(SYS_futex, reinterpret_cast<int *>(&resLimit_), FUTEX_WAIT_PRIVATE, 0, pts, nullptr, 0);
+#else
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (resLimit_.load() == 0)
+        {
+            if (timeout != nullptr)
+            {
+                cond_.wait_for(lock, *timeout);
+            }
+            else
+            {
+                cond_.wait(lock);
+            }
+        }
+#endif
+    }
+
+    void futexWake()
+    {
+#ifdef __linux__
+        syscall(SYS_futex, reinterpret_cast<int *>(&resLimit_), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else
         std::unique_lock<std::mutex> lock(mutex_);
-        ++resLimit;         // 增加信号量计数
-        cond_.notify_all(); // 通知一个等待的线程
+        cond_.notify_one();
+#endif
+    }
+
+private:
+    std::atomic_int resLimit_; // 信号量计数, futex直接等待这个字
+    std::atomic_int waiters_;  // 正在等待(可能进内核)的线程数量
+#ifndef __linux__
+    std::mutex mutex_;             // 非linux平台的慢路径
+    std::condition_variable cond_;
+#endif
+};
+
+// 一组任务共享的完成计数, 由执行完任务的线程递增
+// 等待方只在第一个完成/全部完成时被唤醒一次, 不用逐个get()
+class CountDownLatch
+{
+public:
+    CountDownLatch() : total_(0), arrived_(0) {}
+
+    // 登记一个需要等待的任务
+    void expect() { ++total_; }
+
+    // 一个任务完成
+    void arrive()
+    {
+        int arrived = ++arrived_;
+        if (arrived == 1)
+        {
+            anySem_.post(); // 第一个完成, 唤醒wait_any
+        }
+        if (arrived == total_.load())
+        {
+            allSem_.post(); // 全部完成, 唤醒wait_all
+        }
+    }
+
+    int total() const { return total_.load(); }
+    int arrived() const { return arrived_.load(); }
+
+    // 等待全部完成
+    void waitAll()
+    {
+        while (arrived_.load() < total_.load())
+        {
+            allSem_.wait();
+        }
+    }
+
+    // 最多等待timeout, 全部完成返回true
+    template <typename Rep, typename Period>
+    bool waitAllFor(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (arrived_.load() < total_.load())
+        {
+            if (!allSem_.wait_for(deadline - std::chrono::steady_clock::now()))
+            {
+                return arrived_.load() >= total_.load();
+            }
+        }
+        return true;
+    }
+
+    // 等待至少一个完成
+    void waitAny()
+    {
+        if (arrived_.load() == 0)
+        {
+            anySem_.wait();
+        }
+    }
+
+    // 最多等待timeout, 至少一个完成返回true
+    template <typename Rep, typename Period>
+    bool waitAnyFor(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        return arrived_.load() > 0 || anySem_.wait_for(timeout) || arrived_.load() > 0;
+    }
+
+private:
+    std::atomic_int total_;   // 需要等待的任务数量
+    std::atomic_int arrived_; // 已经完成的任务数量
+    Semaphore anySem_;        // 第一个任务完成时post
+    Semaphore allSem_;        // 全部任务完成时post
+};
+
+// 任务完成状态, 由Result和Task共享
+// Result被移动或者被丢弃, 任务执行完写返回值也不会写到悬空指针上
+class Completion
+{
+public:
+    Completion() : isReady_(false), isCancelled_(false), latch_(nullptr) {}
+
+    // 存储task返回值, 通知等待的线程
+    void setValue(Any any);
+
+    // 任务被取消了, 没有返回值, 等待的线程照样被唤醒
+    void cancel();
+
+    // 任务是否被取消
+    bool isCancelled() const
+    {
+        return isCancelled_.load(std::memory_order_acquire);
+    }
+
+    // 阻塞直到任务完成, 已经完成的话只是一次原子读
+    Any get();
+
+    // 阻塞直到任务完成, 不取返回值
+    void wait()
+    {
+        if (!isReady())
+        {
+            sem_.wait();
+        }
+    }
+
+    // 任务是否已经完成
+    bool isReady() const
+    {
+        return isReady_.load(std::memory_order_acquire);
     }
 
+    // 最多等待timeout, 任务完成返回true
+    template <typename Rep, typename Period>
+    bool wait_for(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        return isReady() || sem_.wait_for(timeout) || isReady();
+    }
+
+    // 挂到一个计数器上, 任务完成时计数器arrive一次
+    // 已经完成的话立即arrive, 一个完成状态同时只能挂一个计数器
+    void attach(std::shared_ptr<CountDownLatch> latch);
+
 private:
-    std::mutex mutex_;             // 互斥锁
-    std::condition_variable cond_; // 条件变量
-    int resLimit;                  // 信号量计数
+    Any any_;                  // 存储任务返回值
+    Semaphore sem_;            // 信号量，用于同步任务完成
+    std::atomic_bool isReady_; // 任务是否完成标志
+    std::atomic_bool isCancelled_; // 任务是否被取消
+
+    // 完成时要通知的计数器, 完成后置为doneMark(), 保证只arrive一次
+    std::atomic<CountDownLatch *> latch_;
+    std::shared_ptr<CountDownLatch> latchRef_; // 保证计数器活得比任务久
+    static CountDownLatch *doneMark() { return reinterpret_cast<CountDownLatch *>(1); }
 };
 
 class Task; // 前向声明Task类
@@ -112,26 +368,107 @@ class Task; // 前向声明Task类
 class Result
 {
 public:
-    Result(std::shared_ptr<Task> task, bool isReady = true);
+    Result(std::shared_ptr<Task> task, bool isValid = true);
     ~Result() = default;
-    Result(Result &&)
-    {
-        // 移动构造函数
-        isReady_ = true; // 移动后任务已准备好
-        task_ = std::move(task_);
-    }
-    // 这两个要好好思考一下
+    // 完成状态是共享的, 移动Result不影响正在执行的任务
+    Result(Result &&) = default;
+    Result &operator=(Result &&) = default;
+
     // 获取返回值并赋值
     void setValue(Any any);
 
-    // 用户获取任务返回值
+    // 用户获取任务返回值, 提交失败的任务返回空的Any
     Any get();
 
+    // 任务是否提交成功
+    bool isValid() const { return isValid_; }
+
+    // 任务是否已经完成(包括被取消), 不阻塞
+    bool isReady() const { return isValid_ && completion_->isReady(); }
+
+    // 任务是否被取消, 被取消的任务get()返回空的Any
+    bool isCancelled() const { return isValid_ && completion_->isCancelled(); }
+
+    // 最多等待timeout, 任务完成返回true
+    template <typename Rep, typename Period>
+    bool wait_for(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        return isValid_ && completion_->wait_for(timeout);
+    }
+
+private:
+    friend class Task;
+    friend class ResultSet;
+
+    std::shared_ptr<Completion> completion_; // 共享的完成状态
+    std::shared_ptr<Task> task_;             // 任务指针
+    bool isValid_;                           // 任务是否提交成功
+};
+
+/*
+**********************************example**************************
+ResultSet results;
+for (int i = 0; i < 100; ++i)
+{
+    results.add(pool.submitTask(std::make_shared<MyTask>(i)));
+}
+int first = results.wait_any(std::chrono::milliseconds(10)); // 第一个完成的下标, 超时返回-1
+results.wait_all();                                           // 只阻塞一次
+*/
+
+// 一组任务结果, 所有任务共享一个完成计数
+// 等待方只阻塞一次, 而不是每个Result各get()一次
+// add()和wait_*()需要在同一个线程里调用
+class ResultSet
+{
+public:
+    ResultSet();
+    ~ResultSet() = default;
+
+    ResultSet(const ResultSet &) = delete;
+    ResultSet &operator=(const ResultSet &) = delete;
+    ResultSet(ResultSet &&) = default;
+    ResultSet &operator=(ResultSet &&) = default;
+
+    // 加入一个任务结果, 返回它的下标
+    size_t add(Result res);
+
+    size_t size() const { return results_.size(); }
+    Result &operator[](size_t i) { return results_[i]; }
+
+    // 已经完成的任务数量, 提交失败的任务也算完成
+    size_t readyCount() const { return latch_->arrived(); }
+
+    // 等待全部完成
+    void wait_all();
+
+    // 最多等待timeout, 全部完成返回true
+    template <typename Rep, typename Period>
+    bool wait_all(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        return latch_->waitAllFor(timeout);
+    }
+
+    // 等待任意一个完成, 返回它的下标; 集合为空返回-1
+    int wait_any();
+
+    // 最多等待timeout, 返回第一个完成的下标, 超时返回-1
+    template <typename Rep, typename Period>
+    int wait_any(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        if (results_.empty() || !latch_->waitAnyFor(timeout))
+        {
+            return -1;
+        }
+        return firstReady();
+    }
+
 private:
-    Any any_;                    // 存储任务返回值
-    Semaphore sem_;              // 信号量，用于同步任务完成
-    std::shared_ptr<Task> task_; // 任务指针
-    std::atomic_bool isReady_;   // 任务是否完成标志
+    int firstReady() const;
+
+private:
+    std::vector<Result> results_;
+    std::shared_ptr<CountDownLatch> latch_; // 所有任务共享的完成计数
 };
 
 // 线程池模式
@@ -141,6 +478,62 @@ enum class PoolMode
     MODE_CACHED, // 动态变化线程池
 };
 
+class ThreadPoolBase; // 前向声明线程池类
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+class BasicThreadPool;
+class ExecutorGroup;
+struct ExecutorSlot;
+class IoReactor;
+class Task;
+
+/*
+**********************************example**************************
+CancellationToken token;                       // 拷贝出来的token共享同一个取消状态
+pool.submitTask(std::make_shared<MyTask>(), token);
+pool.submitTask(std::make_shared<MyTask>(), token);
+token.cancel(); // 还在排队的任务不再执行, 结果标记为取消; 正在执行的任务自己调用isCancelled()检查
+*/
+
+// 协作式取消
+// 取消时还在队列里的任务直接标记为完成(取消), 马上让出队列名额, 工作线程取到时跳过
+class CancellationToken
+{
+public:
+    CancellationToken();
+    ~CancellationToken() = default;
+
+    // 不能取消的空token, submitTask的默认参数
+    static CancellationToken none() { return CancellationToken(nullptr); }
+
+    // 取消所有用这个token提交的任务, 之后再提交的任务也直接取消
+    void cancel();
+
+    // 是否已经取消
+    bool isCancelled() const;
+
+private:
+    friend class Task;
+    template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+    friend class BasicThreadPool;
+
+    struct State
+    {
+        State() : cancelled_(false), pruneSize_(16) {}
+
+        std::atomic_bool cancelled_;
+        std::mutex mutex_;
+        std::vector<std::weak_ptr<Task>> tasks_; // 用这个token提交的任务
+        size_t pruneSize_;                       // tasks_超过这个数量时清理已经结束的任务
+    };
+
+    explicit CancellationToken(std::nullptr_t) {}
+
+    // 提交的任务入队以后登记, 登记时已经取消的话返回false
+    bool track(const std::shared_ptr<Task> &task);
+
+    std::shared_ptr<State> state_;
+};
+
 // 抽象任务基类
 class Task
 {
@@ -152,8 +545,39 @@ public:
     void setResult(Result *res);
     virtual Any run() = 0;
 
+    // 任务排队时占用的内存(字节), 用于按字节限制排队的任务
+    // 默认只算任务对象本身的大概大小, 带着大块数据的任务重写它, 返回数据的大小
+    virtual size_t footprint() const { return sizeof(Task); }
+
+    // 调用方给任务打的标签, 线程池记录负载时原样写进记录
+    void setTag(uint32_t tag) { tag_ = tag; }
+    uint32_t tag() const { return tag_; }
+
+    // 提交时带的token是否已经取消, 执行时间长的任务可以在run()里轮询
+    bool isCancelled() const
+    {
+        return cancelState_ != nullptr && cancelState_->cancelled_.load(std::memory_order_relaxed);
+    }
+
 private:
-    Result *result_; // 任务执行结果
+    friend class ThreadPoolBase;
+    template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+    friend class BasicThreadPool;
+    friend class CancellationToken;
+
+    // 抢占执行权, 只有第一个抢到的线程执行任务
+    // 队列里的工作线程和在get()里帮忙的线程都可能拿到同一个任务
+    bool tryClaim() { return !claimed_.exchange(true); }
+
+    std::shared_ptr<Completion> result_; // 任务执行结果
+    ThreadPoolBase *pool_;               // 任务提交到的线程池
+    std::atomic_bool claimed_;           // 任务是否已经被某个线程拿走执行
+    std::shared_ptr<CancellationToken::State> cancelState_; // 提交时带的取消状态
+    size_t queuedBytes_;                 // 入队时记下的footprint(), 出队时原样扣掉
+    int64_t enqueueNs_;                  // 入队的时刻, 打开排队时间准入控制时才记
+    uint32_t tag_;                       // 调用方给的标签
+    uint32_t submitThread_;              // 提交线程的编号, 记录负载时才记
+    int64_t submitNs_;                   // 提交的时刻, 记录负载时才记, 否则为0
 };
 
 // 线程类型
@@ -162,22 +586,28 @@ class Thread
 public:
     using ThreadFunc = std::function<void(int)>;
 
-    // 构造函数，传入线程函数
-    Thread(ThreadFunc func);
+    // 构造函数，传入线程函数和线程ID(在线程池注册表里的下标)
+    Thread(ThreadFunc func, int threadId);
 
-    // 析构函数
+    // 析构函数, 线程还没回收的话等它结束
     ~Thread();
 
+    Thread(const Thread &) = delete;
+    Thread &operator=(const Thread &) = delete;
+
     // 启动线程
     void start();
 
+    // 等待线程结束
+    void join();
+
     // 获取线程ID
     int getThreadId() const;
 
 private:
     ThreadFunc func_; // 线程函数
     int threadId_; // 保存线程ID
-    static int generate_id; // 静态变量，用于生成唯一的线程ID
+    std::thread thread_; // 不分离, 由线程池回收
 
 };
 
@@ -197,62 +627,1769 @@ pool.submitTask(std::make_shared<MyTask>()); // 提交任务到线程池
 
 */
 
-// 线程池类型
-class ThreadPool
+// 所有线程池实例共同的基类
+// Task/Result/CancellationToken/blocking_scope只认识这个类型, 不关心线程池的模板参数
+class ThreadPoolBase
 {
 public:
-    ThreadPool();
-    ~ThreadPool();
+    virtual ~ThreadPoolBase();
 
-    // 设置线程池模式
-    void setMode(PoolMode mode);
+    // 任务里包住阻塞调用(磁盘/锁/sleep)的RAII守卫
+    // 持有期间这个工作线程不算可用线程, 有任务排队时补偿一个线程, 离开后多出来的线程退出
+    // 在工作线程之外使用什么都不做, 可以嵌套
+    class blocking_scope
+    {
+    public:
+        blocking_scope();
+        ~blocking_scope();
 
-    // 设置task队列最大线程数
-    void setTaskQueMaxThreshHold(int size);   // 不是优化掉, start直接传入, 而是两种情况 都可以
+        blocking_scope(const blocking_scope &) = delete;
+        blocking_scope &operator=(const blocking_scope &) = delete;
 
-    // 设置线程池线程数量阈值, 用于动态变化线程池模式
-    void setThreadSizeThreshHold(int size);
+    private:
+        ThreadPoolBase *pool_;                  // 进入阻塞区的线程池, 不是最外层的话为nullptr
+        static thread_local int blockingDepth_; // 当前线程嵌套的阻塞区层数
+    };
 
-    
+    // 打开/关闭线程池的调试日志, 所有线程池共用
+    static void setLogEnabled(bool enabled) { logEnabled_ = enabled; }
+    static bool isLogEnabled() { return logEnabled_; }
 
-    // 提交任务到线程池
-    Result submitTask(std::shared_ptr<Task> sp);
+    // 当前线程是不是某个线程池的工作线程
+    static bool isWorkerThread() { return currentPool_ != nullptr; }
 
-    // 开启线程池
-    void start(int initThreadSize = std::thread::hardware_concurrency());
+    // 在当前工作线程上执行一个排队的任务, 只取本线程的本地队列和全局队列, 不偷别的线程的
+    // 不是工作线程、帮忙执行的嵌套层数到了HELP_DEPTH_MAX、或者没有任务时返回false
+    // 等待的线程在栈上帮忙用, 执行到的任务如果反过来等这个线程, 谁都动不了, 调用方自己保证不会这样
+    static bool runPendingTask();
 
-    // 禁止拷贝和赋值
-    ThreadPool(const ThreadPool &) = delete;
-    ThreadPool &operator=(const ThreadPool &) = delete;
+    // 线程池自带的I/O反应器, 第一次调用时创建反应器线程
+    // 异步读写的回调作为任务回到本线程池上执行
+    IoReactor &reactor();
 
-private:
-    // 定义线程函数
-    void threadFunc(int threadid);
+protected:
+    friend class Result;
+    friend class ExecutorGroup;
+    friend class CancellationToken;
+    friend class IoReactor;
 
-    bool checkPoolState() const;
+    // 每个工作线程的本地队列, 任务里嵌套提交的任务放这里
+    // 本线程从尾部取(后进先出, 分治任务局部性好), 空闲线程从头部偷
+    struct LocalQueue
+    {
+        std::mutex mutex_;
+        std::deque<std::shared_ptr<Task>> que_;
+    };
+
+    // 工作线程注册表里的一个槽位, 下标就是线程ID
+    // 线程退出后槽位留着线程对象, 下次复用槽位或者线程池析构时再join
+    struct WorkerSlot
+    {
+        std::unique_ptr<Thread> thread_;
+        LocalQueue localQue_;
+        bool live_ = false; // 槽位上有没有在运行的工作线程, taskQueMutex_保护
+    };
+
+    ThreadPoolBase();
+
+    // 排队中的任务被取消(已经抢到执行权), 归还队列名额, 完成结果
+    virtual void cancelQueuedTask(Task *task) = 0;
+
+    // 工作线程进入/离开阻塞区
+    virtual void enterBlocking() = 0;
+    virtual void leaveBlocking() = 0;
+
+    // 当前工作线程在get()里等awaited完成, 期间执行其他任务
+    virtual void help(Task *awaited, Completion *done) = 0;
+
+    // 从本线程的本地队列或者全局队列取一个任务执行, 没有任务返回false
+    virtual bool helpOnce() = 0;
+
+    // 投递内部任务(I/O完成的回调), 不受任务队列阈值限制, 不会失败
+    virtual void post(std::shared_ptr<Task> sp) = 0;
+
+    // 停掉反应器, 还没完成的I/O回调带着-ECANCELED投递出来, 析构时在工作线程退出前调用
+    void stopReactor();
+
+    // 工作线程在Result::get()里等待时, 执行其他任务, 优先执行等待的那个
+    // 不是工作线程调用的话直接返回
+    static void helpWhileWaiting(Task *awaited, Completion *done)
+    {
+        if (currentPool_ != nullptr)
+        {
+            currentPool_->help(awaited, done);
+        }
+    }
+
+    // 提交任务的线程的编号, 每个线程第一次调用时按顺序分配, 之后不变
+    static unsigned producerIndex();
+
+    // 向执行组申请/归还执行名额, 记在holdingGroupSlot_上
+    void acquireGroupSlot();
+    void releaseGroupSlot();
+    bool groupHasWaiters() const;
+
+protected:
+    // 当前线程如果是工作线程, 记录它所属的线程池和本地队列
+    // 嵌套提交和get()里帮忙执行任务都靠这个判断
+    static thread_local ThreadPoolBase *currentPool_;
+    static thread_local LocalQueue *currentLocalQue_;
+    static thread_local int currentThreadId_;
+    static thread_local int helpDepth_; // runPendingTask和get()里帮忙执行任务嵌套的层数
+
+    static std::atomic_bool logEnabled_; // 是否打印调试日志
+
+    ExecutorGroup *group_;     // 所属的执行组, 没有的话为nullptr
+    ExecutorSlot *groupSlot_;  // 在执行组里的位置
+    static thread_local bool holdingGroupSlot_; // 当前工作线程是否拿着执行组的名额
+
+    std::once_flag reactorOnce_;
+    std::unique_ptr<IoReactor> reactor_; // 没用过I/O的线程池为nullptr
+};
+
+// 调试日志, 压测的时候用ThreadPool::setLogEnabled(false)关掉
+#define POOL_LOG(msg) \
+    do \
+    { \
+        if (ThreadPoolBase::isLogEnabled()) \
+        { \
+            std::cout << msg << std::endl; \
+        } \
+    } while (0)
+
+const int TASK_MAX_THRESHOLD = 2;//INT32_MAX;    // 任务队列最大阈值
+const int Thread_MAX_THRESHOLD = 10; // 线程池最大线程数阈值
+const int THREAD_TIMEOUT = 10; // 线程空闲时间超过60s, 则回收多余的线程
+const auto GROUP_TIME_SLICE = std::chrono::milliseconds(10); // 执行组里一个线程连续占用执行名额的时间片
+const int DEQUEUE_BATCH_MAX = 32; // 工作线程一次从全局队列最多拿的任务数量
+const uint64_t BATCH_TASK_NS = 20000; // 自适应批量: 任务平均耗时超过20us就一次只拿一个
+const int INJECT_QUEUE_MAX = 64; // 外部提交分片队列的最大数量
+const int HELP_DEPTH_MAX = 2; // 等待时在栈上帮忙执行任务的最大嵌套层数
+const auto HELP_WAIT_MAX = std::chrono::milliseconds(32); // get()里没有任务可帮忙时一次最多睡多久
+
+// 线程池运行状态的快照, 各项分别读取, 不是同一时刻的
+struct PoolStats
+{
+    size_t threadSize_;     // 当前线程数量(包括阻塞区里的)
+    size_t idleThreadSize_; // 空闲线程数量
+    size_t queuedTasks_;    // 排队的任务数量(全局队列+本地队列)
+    size_t queuedBytes_;    // 排队的任务占用的内存, 按footprint()累加
+    bool overloaded_;       // 排队时间准入控制判断为过载, 正在拒绝新任务
+    uint64_t shedTasks_;    // 排队时间准入控制拒绝的任务数量
+    int64_t minQueueDelayNs_; // 上一个区间任务最小的排队时间, 没打开准入控制时为0
+};
+
+// 默认的任务生命周期钩子, 什么都不做, 编译后不留任何代码
+// 自定义钩子照着这几个函数写一个类, 作为模板参数传给BasicThreadPool
+// onSubmit在提交任务的线程上调用, 其余在工作线程上调用
+struct NoHooks
+{
+    void onSubmit(Task &) {}
+    void onStart(Task &) {}
+    void onFinish(Task &) {}
+    void onWorkerStart(int) {}
+    void onWorkerExit(int) {}
+};
+
+/*
+**********************************example**************************
+struct TenantHooks
+{
+    void onSubmit(Task &task) { ... 记下提交线程上的请求ID ... }
+    void onStart(Task &task) { ... }
+    void onFinish(Task &task) { ... 给租户记CPU时间 ... }
+    void onWorkerStart(int threadid) {}
+    void onWorkerExit(int threadid) {}
+};
+BasicThreadPool<TenantHooks> pool;  // 钩子直接内联进执行路径, 没有间接调用
+pool.start(4);
+pool.hooks();                        // 访问钩子对象
+*/
+
+// **************************全局任务队列策略*****************************
+// 队列策略是一个以分配器为参数的类模板, 提供push/pop/empty/size/removeIf
+// 全部在taskQueMutex_保护下调用
+
+// 先进先出, 默认
+template <typename Alloc>
+class FifoTaskQueue
+{
+public:
+    void push(std::shared_ptr<Task> task) { que_.emplace_back(std::move(task)); }
+
+    // 调用方保证队列不空
+    std::shared_ptr<Task> pop()
+    {
+        std::shared_ptr<Task> task = std::move(que_.front());
+        que_.pop_front();
+        return task;
+    }
+
+    bool empty() const { return que_.empty(); }
+    size_t size() const { return que_.size(); }
+
+    // 删掉满足条件的任务, 保持其余任务的顺序
+    template <typename Pred>
+    void removeIf(Pred pred)
+    {
+        que_.erase(std::remove_if(que_.begin(), que_.end(), pred), que_.end());
+    }
 
 private:
-    // std::vector<std::unique_ptr<Thread>> threads_; // 线程列表
-    std::unordered_map<int, std::unique_ptr<Thread>> threads_; // 线程列表, 使用unordered_map存储线程对象
-    size_t initThreadSize_;                        // 初始线程数量
-    std::atomic_uint idleThreadSize_; // 空闲线程数量-cached需要
-    std::atomic_uint ThreadSizeThreshold_; // 线程池线程数量阈值, 用于动态变化线程池模式 cached需要
-    std::atomic_uint currentThreadSize_; // 线程池当前线程总数量 cached需要
+    std::deque<std::shared_ptr<Task>, Alloc> que_;
+};
 
-    std::queue<std::shared_ptr<Task>> taskQue_; // 任务队列
-    std::atomic_uint taskSize_;                 // 任务数量  线程安全
-    int taskQueMaxThreshHold_;                  // 任务队列最大线程数, 阈值
+// 后进先出, 刚提交的任务数据还在缓存里, 适合不关心公平性的场景
+template <typename Alloc>
+class LifoTaskQueue
+{
+public:
+    void push(std::shared_ptr<Task> task) { que_.emplace_back(std::move(task)); }
 
-    std::mutex taskQueMutex_;          // 任务队列互斥锁
-    std::condition_variable notFull_;  // 任务队列不满
-    std::condition_variable notEmpty_; // 任务队列不空
-    std::condition_variable exitCond_; // 线程池退出条件变量
-    std::condition_variable startCond_; // 线程池全部启动条件变量 -- 复现死锁本人解决办法
+    // 调用方保证队列不空
+    std::shared_ptr<Task> pop()
+    {
+        std::shared_ptr<Task> task = std::move(que_.back());
+        que_.pop_back();
+        return task;
+    }
 
-    PoolMode poolmode_; // 当前线程池模式
-    std::atomic_bool isPoolRunning_; // 线程池是否正在运行
+    bool empty() const { return que_.empty(); }
+    size_t size() const { return que_.size(); }
 
-   
+    template <typename Pred>
+    void removeIf(Pred pred)
+    {
+        que_.erase(std::remove_if(que_.begin(), que_.end(), pred), que_.end());
+    }
+
+private:
+    std::vector<std::shared_ptr<Task>, Alloc> que_;
 };
 
-#endif
\ No newline at end of file
+// **************************空闲等待策略*****************************
+// 工作线程没有任务时怎么等, 调用时持有lock, 返回时也持有lock
+// pred只读原子变量, 可以在不持锁的时候求值
+
+// 直接睡在条件变量上, 默认
+struct BlockingWait
+{
+    template <typename Pred>
+    static void wait(std::unique_lock<std::mutex> &lock, std::condition_variable &cond, Pred pred)
+    {
+        cond.wait(lock, pred);
+    }
+
+    template <typename Duration, typename Pred>
+    static bool waitFor(std::unique_lock<std::mutex> &lock, std::condition_variable &cond,
+        Duration timeout, Pred pred)
+    {
+        return cond.wait_for(lock, timeout, pred);
+    }
+};
+
+// 先放开锁自旋Spins次, 还没有任务再睡, 任务一个接一个来的时候省掉唤醒延迟, 代价是空转CPU
+template <int Spins = 4000>
+struct SpinThenBlockWait
+{
+    template <typename Pred>
+    static void wait(std::unique_lock<std::mutex> &lock, std::condition_variable &cond, Pred pred)
+    {
+        if (!spin(lock, pred))
+        {
+            cond.wait(lock, pred);
+        }
+    }
+
+    template <typename Duration, typename Pred>
+    static bool waitFor(std::unique_lock<std::mutex> &lock, std::condition_variable &cond,
+        Duration timeout, Pred pred)
+    {
+        return spin(lock, pred) || cond.wait_for(lock, timeout, pred);
+    }
+
+private:
+    template <typename Pred>
+    static bool spin(std::unique_lock<std::mutex> &lock, Pred &pred)
+    {
+        lock.unlock();
+        bool ready = false;
+        for (int i = 0; i < Spins && !ready; ++i)
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+            ready = pred();
+        }
+        lock.lock();
+        return ready && pred();
+    }
+};
+
+// **************************线程数量策略*****************************
+// elastic(): 是否按需创建线程、回收空闲线程; idleTimeout(): 空闲多久回收
+
+// 运行时按setMode()设置的模式决定, 默认
+struct ModeGrowth
+{
+    static bool elastic(PoolMode mode) { return mode == PoolMode::MODE_CACHED; }
+    static std::chrono::seconds idleTimeout() { return std::chrono::seconds(THREAD_TIMEOUT); }
+};
+
+// 编译期固定线程数量, 忽略setMode()
+struct FixedGrowth
+{
+    static bool elastic(PoolMode) { return false; }
+    static std::chrono::seconds idleTimeout() { return std::chrono::seconds(THREAD_TIMEOUT); }
+};
+
+// 编译期按需增长, 忽略setMode(), IdleSeconds秒没有任务的线程回收
+template <int IdleSeconds = THREAD_TIMEOUT>
+struct CachedGrowth
+{
+    static bool elastic(PoolMode) { return true; }
+    static std::chrono::seconds idleTimeout() { return std::chrono::seconds(IdleSeconds); }
+};
+
+/*
+**********************************example**************************
+// 低延迟: 后进先出 + 先自旋再睡 + 固定线程数, 队列节点从内存池分配
+using FastPool = BasicThreadPool<NoHooks,
+                                 LifoTaskQueue,
+                                 SpinThenBlockWait<10000>,
+                                 std::pmr::polymorphic_allocator<std::shared_ptr<Task>>,
+                                 FixedGrowth>;
+FastPool pool;
+pool.start(4);
+*/
+
+// 线程池类型, 每个策略编译期选定, 热路径上没有虚函数调用
+// Hooks: 任务生命周期钩子
+// Queue: 全局任务队列, 以Allocator为参数的类模板
+// WaitStrategy: 工作线程空闲时的等待方式
+// Allocator: 全局任务队列的分配器
+// Growth: 线程数量是否随任务增长
+template <typename Hooks = NoHooks,
+          template <typename> class Queue = FifoTaskQueue,
+          typename WaitStrategy = BlockingWait,
+          typename Allocator = std::allocator<std::shared_ptr<Task>>,
+          typename Growth = ModeGrowth>
+class BasicThreadPool : public ThreadPoolBase, private Hooks
+{
+public:
+    explicit BasicThreadPool(Hooks hooks = Hooks());
+    ~BasicThreadPool();
+
+    // 设置线程池模式, Growth不是ModeGrowth的话不起作用
+    void setMode(PoolMode mode);
+
+    // 设置task队列最大线程数
+    void setTaskQueMaxThreshHold(int size);   // 不是优化掉, start直接传入, 而是两种情况 都可以
+
+    // 设置排队任务占用内存的上限(字节), 和任务数量上限同时起作用, 0表示不限制
+    // 超过上限的提交和任务数量满了一样, 最多等1s, 还是放不下就提交失败
+    // 队列是空的时候, 比上限还大的任务也能进去, 不会永远提交不了
+    void setTaskQueMaxBytes(size_t bytes);
+
+    // 设置工作线程一次从全局队列拿几个任务, 多拿的放进自己的本地队列, 空闲的线程可以偷走
+    // 1: 一次一个(默认); 0: 自适应, 按队列深度和任务平均耗时决定; 最多DEQUEUE_BATCH_MAX个
+    void setDequeueBatch(int batch);
+
+    // 外部线程提交的任务分到count个注入队列里, 每个提交线程固定用一个, 提交时不碰taskQueMutex_(有空闲线程要叫醒时除外)
+    // 工作线程在全局队列空了以后轮流从各个注入队列取, 同一个线程提交的任务按提交顺序出队
+    // 注入队列按先进先出, 不走Queue策略的排序; 队列名额的检查不加锁, 多个线程同时提交时可能略超过上限
+    // 0: 不分片(默认); 最多INJECT_QUEUE_MAX个
+    void setInjectQueues(int count);
+
+    // 按排队时间拒绝新任务(CoDel): 每个interval里任务最小的排队时间都超过target, 下一个区间拒绝外部提交
+    // 拒绝时submitTask马上返回无效的Result, 不等1s; 工作线程里嵌套提交的任务不拒绝; target为0表示关闭(默认)
+    void setQueueDelayTarget(std::chrono::nanoseconds target,
+                             std::chrono::nanoseconds interval = std::chrono::milliseconds(100));
+
+    // 开始/结束记录负载: 之后提交的每个任务执行完时, 把提交时刻、提交线程、执行耗时和标签写进文件
+    // 用tools/workload_replay离线重放; 运行中可以随时开关, 打不开文件返回false
+    bool startRecording(const std::string &path) { return recorder_.start(path); }
+    void stopRecording() { recorder_.stop(); }
+
+    // 自动调整线程数: 每个周期按完成任务的吞吐量爬山, 线程数保持在[minThreads, maxThreads]
+    // start()的初始线程数是爬山的起点; cached模式的线程数量阈值跟着调整后的线程数走
+    void setAutoTune(int minThreads, int maxThreads,
+                     std::chrono::milliseconds period = std::chrono::milliseconds(500));
+
+    // 每period重新读一次root下的cgroup CPU配额, 变了就跟着调整线程数
+    // 没有自动调整时线程数直接调成新的可用CPU数; 自动调整时从新的值重新爬
+    void watchCpuQuota(std::chrono::milliseconds period = std::chrono::seconds(1),
+                       std::string root = CGROUP_ROOT);
+
+    // 设置线程池线程数量阈值, 用于动态变化线程池模式
+    void setThreadSizeThreshHold(int size);
+
+    
+
+    // 提交任务到线程池, 可以带一个取消token
+    Result submitTask(std::shared_ptr<Task> sp, CancellationToken token = CancellationToken::none());
+
+    // 和submitTask一样, 但任务队列满了不等空位, 马上返回无效的Result, 调用方自己决定重试还是退回
+    Result trySubmitTask(std::shared_ptr<Task> sp, CancellationToken token = CancellationToken::none());
+
+    // 开启线程池
+    // 默认线程数是进程实际能用的CPU数量(affinity和cgroup配额), 不是宿主机的核数
+    void start(int initThreadSize = CpuQuota::defaultConcurrency());
+
+    // 钩子对象
+    Hooks &hooks() { return *this; }
+
+    // 当前线程数量(包括阻塞区里的)
+    size_t threadSize() const { return currentThreadSize_; }
+
+    // 运行状态
+    PoolStats stats() const
+    {
+        return PoolStats{currentThreadSize_, idleThreadSize_, taskSize_, queuedBytes_,
+                         codel_.isOverloaded(), codel_.shedCount(), codel_.minDelayNs()};
+    }
+
+    // 禁止拷贝和赋值
+    BasicThreadPool(const BasicThreadPool &) = delete;
+    BasicThreadPool &operator=(const BasicThreadPool &) = delete;
+
+private:
+    // 定义线程函数
+    void threadFunc(int threadid);
+
+    bool checkPoolState() const;
+
+    // 创建并启动一个线程, 调用方持有taskQueMutex_, 注册表满了返回false
+    bool addThread();
+
+    // 当前线程退出前归还自己的槽位, 调用方持有taskQueMutex_, 并且本地队列已经空了
+    void releaseSlot(int threadid);
+
+    // 从本地队列尾部取一个还没被拿走的任务
+    std::shared_ptr<Task> takeLocalTask(LocalQueue *localQue);
+
+    // 从全局队列取, 再从注入队列取, 都取不到就从其他线程的本地队列头部偷, 调用方持有taskQueMutex_
+    // batch大于1时从取到任务的队列多拿batch-1个放进本线程的本地队列
+    std::shared_ptr<Task> takeTask(int threadid, size_t batch = 1);
+
+    // 只从全局队列取, 调用方持有taskQueMutex_
+    std::shared_ptr<Task> takeGlobalTask(int threadid, size_t batch = 1);
+
+    // 从que头部再拿最多batch-1个没被抢走的任务, 按原来的顺序放进本线程的本地队列, 调用方持有que的锁
+    void takeBatch(int threadid, Queue<Allocator> *que, std::deque<std::shared_ptr<Task>> *inject, size_t batch);
+
+    // 这次从全局队列拿几个, 调用方持有taskQueMutex_
+    size_t dequeueBatchSize(uint64_t avgTaskNs) const;
+
+    // 执行一个已经抢到执行权的任务, 前后调用钩子
+    void runTask(Task *task);
+
+    // 任务执行完, 叫醒在get()里睡着的线程看看是不是它等的; 调用方不能持有taskQueMutex_
+    void wakeHelpers();
+
+    // cached模式下是否需要再创建线程
+    bool needMoreThreads() const;
+
+    // 阻塞区里的线程还没补偿够, 又有任务排着
+    bool needCompensation() const;
+
+    // 给阻塞区里的线程补偿一个线程, 调用方持有taskQueMutex_
+    void compensateBlocking();
+
+    // 任务进入队列/离开队列, 记任务数量和字节数
+    // dequeued: 被拿去执行, 排队时间报告给准入控制; 被取消的不算
+    void enterQueue(Task *task);
+    void leaveQueue(Task *task, bool dequeued = true);
+
+    // 按字节的上限, 再放进bytes字节的任务是否可以
+    bool bytesAdmissible(size_t bytes) const;
+
+    // submitTask和trySubmitTask的实现, 队列满时最多等wait
+    Result submitTaskFor(std::shared_ptr<Task> sp, CancellationToken token, std::chrono::milliseconds wait);
+
+    void cancelQueuedTask(Task *task) override;
+    void enterBlocking() override;
+    void leaveBlocking() override;
+    void help(Task *awaited, Completion *done) override;
+    bool helpOnce() override;
+    void post(std::shared_ptr<Task> sp) override;
+
+    // 自动调整线程数的线程函数
+    void tuneLoop();
+
+    // cgroup配额变了, 在监视线程上调用
+    void onCpuQuotaChanged(int cpus);
+
+    // 把线程数(不算阻塞区的补偿线程)调到target, 多的在两个任务之间退出
+    void resizeTo(int target);
+
+    // 有待退出的补偿线程的话, 当前线程退出, 返回true
+    bool tryRetire(int threadid, LocalQueue *localQue);
+
+    // 回收当前线程, 调用方持有taskQueMutex_, 并且本地队列已经空了
+    void retireThread(int threadid);
+
+private:
+    // std::vector<std::unique_ptr<Thread>> threads_; // 线程列表
+    std::unique_ptr<WorkerSlot[]> workers_; // 工作线程注册表, 容量在start()时定下来, 之后不再变
+    int workerCapacity_;                    // 注册表容量
+    std::vector<int> freeSlots_;            // 空闲的槽位, taskQueMutex_保护
+    size_t initThreadSize_;                        // 初始线程数量
+    std::atomic_uint idleThreadSize_; // 空闲线程数量-cached需要
+    std::atomic_uint ThreadSizeThreshold_; // 线程池线程数量阈值, 用于动态变化线程池模式 cached需要
+    std::atomic_uint currentThreadSize_; // 线程池当前线程总数量 cached需要
+
+    Queue<Allocator> taskQue_; // 任务队列
+    std::atomic_uint taskSize_;                 // 任务数量(全局队列+本地队列里还没被拿走、没被取消的)  线程安全
+    int taskQueMaxThreshHold_;                  // 任务队列最大线程数, 阈值, 和taskSize_比较, 取消的任务马上让出名额
+    std::atomic_size_t queuedBytes_;            // 排队任务的footprint()之和, 和taskSize_同时增减
+    size_t taskQueMaxBytes_;                    // 排队任务占用内存的上限, 0表示不限制
+    int dequeueBatch_;                          // 一次从全局队列拿几个, 0表示自适应
+    int injectQueSize_;                         // 注入队列数量, 0表示不分片
+    std::unique_ptr<LocalQueue[]> injectQues_;  // 外部提交的注入队列, start()时建好
+    int injectCursor_;                          // 下一个去取的注入队列, taskQueMutex_保护
+    CoDelController codel_;                     // 按排队时间的准入控制
+    WorkloadRecorder recorder_;                 // 负载记录, 默认关闭
+
+    std::mutex taskQueMutex_;          // 任务队列互斥锁
+    std::condition_variable notFull_;  // 任务队列不满
+    std::condition_variable notEmpty_; // 任务队列不空
+    std::condition_variable startCond_; // 线程池全部启动条件变量 -- 复现死锁本人解决办法
+
+    PoolMode poolmode_; // 当前线程池模式
+    std::atomic_bool isPoolRunning_; // 线程池是否正在运行
+
+    std::atomic_uint blockingThreadSize_;   // 在阻塞区里的线程数量
+    std::atomic_uint compensateThreadSize_; // 为阻塞区补偿出来的线程数量
+    std::atomic_uint retireThreadSize_;     // 阻塞区结束后/自动调整减少线程时等着退出的线程数量
+    std::atomic_uint helpWaiters_;          // 在get()里没有任务可帮忙, 睡在notEmpty_上的线程数量
+
+    int tuneMinThreads_;                    // 自动调整的下限
+    int tuneMaxThreads_;                    // 自动调整的上限, 0表示不自动调整
+    std::chrono::milliseconds tunePeriod_;  // 自动调整的周期
+    std::atomic<uint64_t> completedTasks_;  // 执行完的任务数量, 自动调整时才计数
+    std::thread tuneThread_;                // 自动调整线程
+    std::mutex tuneMutex_;
+    std::condition_variable tuneCond_;
+    bool tuneStop_;                         // 析构时让自动调整线程退出, tuneMutex_保护
+    std::atomic_int quotaHint_;             // 配额变化后的CPU数量, 自动调整线程取走后清0
+
+    std::chrono::milliseconds quotaPeriod_; // 重新读cgroup配额的周期, 0表示不监视
+    std::string quotaRoot_;                 // cgroup目录
+    std::unique_ptr<CpuQuotaWatcher> quotaWatcher_; // 配额监视线程
+};
+
+// 默认配置的线程池: 先进先出, 条件变量等待, 按模式增长
+using ThreadPool = BasicThreadPool<>;
+
+// **************************线程池实现*****************************
+// 模板实现放在头文件里, 默认配置在threadpool.cc里显式实例化
+
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::BasicThreadPool(Hooks hooks)
+    : Hooks(std::move(hooks)), workerCapacity_(0),
+    idleThreadSize_(0), ThreadSizeThreshold_(Thread_MAX_THRESHOLD), currentThreadSize_(0),
+    taskSize_(0), taskQueMaxThreshHold_(TASK_MAX_THRESHOLD),
+    queuedBytes_(0), taskQueMaxBytes_(0), dequeueBatch_(1), injectQueSize_(0), injectCursor_(0),
+    poolmode_(PoolMode::MODE_FIXED), isPoolRunning_(false),
+    blockingThreadSize_(0), compensateThreadSize_(0), retireThreadSize_(0), helpWaiters_(0),
+    tuneMinThreads_(1), tuneMaxThreads_(0), tunePeriod_(500), completedTasks_(0), tuneStop_(false),
+    quotaHint_(0), quotaPeriod_(0), quotaRoot_(CGROUP_ROOT)
+{
+    // 初始化线程池
+}
+
+// 线程池析构函数
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::~BasicThreadPool()
+{
+    /*-- 复现死锁本人解决办法
+    std::cout << "线程池析构函数 调用..." << std::endl;
+    std::unique_lock<std::mutex> lock(taskQueMutex_);
+    startCond_.wait(lock, [&]() -> bool
+        {
+            return taskQue_.size() == 0;
+        });
+    lock.unlock();
+    */
+
+    // 睡一秒
+    // std::this_thread::sleep_for(std::chrono::seconds(1)); // 睡一秒, 等待线程池全部启动
+
+    POOL_LOG("线程池析构函数被调用, 正在关闭线程池...");
+
+    // 先停反应器, 取消的I/O回调还能在下面退出前执行完
+    stopReactor();
+
+    // 再停配额监视和自动调整, 之后不会再有人创建线程
+    quotaWatcher_.reset();
+    if (tuneThread_.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> guard(tuneMutex_);
+            tuneStop_ = true;
+        }
+        tuneCond_.notify_all();
+        tuneThread_.join();
+    }
+
+    isPoolRunning_ = false; // 设置线程池不在运行状态
+    {
+        std::unique_lock<std::mutex> lock(taskQueMutex_);
+
+        /*-- 复现死锁本人解决办法
+        lock.lock(); // 获取锁
+        */
+
+        // 所有线程完成任务了, 此时都在等待 状态, 先唤醒
+        notEmpty_.notify_all(); // 通知所有线程有任务了
+        POOL_LOG("唤醒所有线程, 准备析构线程池...");
+    }
+
+    // 等待所有线程结束: 阻塞 & 任务执行中的线程执行完剩下的任务才退出
+    // 注册表容量不变, 不用加锁; 已经退出的线程join马上返回
+    for (int i = 0; i < workerCapacity_; ++i)
+    {
+        if (workers_[i].thread_ != nullptr)
+        {
+            workers_[i].thread_->join();
+        }
+    }
+    POOL_LOG("线程池已关闭, 所有线程已回收!");
+
+}
+
+// 检查线程池状态
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+bool BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::checkPoolState() const
+{
+    // 检查线程池是否正在运行
+    return isPoolRunning_;
+}
+
+// 设置线程池模式--手动设置
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::setMode(PoolMode mode)
+{
+    if (checkPoolState() != true) // 线程池未运行
+    {
+        poolmode_ = mode; // 设置线程池模式
+    }
+    else
+    {
+        std::cerr << "线程池已经在运行, 无法修改模式!" << std::endl;
+        return;
+    }
+}
+
+// 设置task队列最大线程数
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::setTaskQueMaxThreshHold(int size)
+{
+    if (checkPoolState() == true)
+    {
+        std::cerr << "线程池已经在运行, 无法修改任务队列最大线程数!" << std::endl;
+        return;
+    }
+    taskQueMaxThreshHold_ = size; // 设置任务队列最大线程数
+}
+
+// 设置排队任务占用内存的上限
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::setTaskQueMaxBytes(size_t bytes)
+{
+    if (checkPoolState() == true)
+    {
+        std::cerr << "线程池已经在运行, 无法修改任务队列内存上限!" << std::endl;
+        return;
+    }
+    taskQueMaxBytes_ = bytes;
+}
+
+// 设置一次从全局队列拿几个任务
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::setDequeueBatch(int batch)
+{
+    if (checkPoolState() == true)
+    {
+        std::cerr << "线程池已经在运行, 无法修改批量取任务的数量!" << std::endl;
+        return;
+    }
+    dequeueBatch_ = std::min(std::max(batch, 0), DEQUEUE_BATCH_MAX);
+}
+
+// 设置外部提交的注入队列数量
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::setInjectQueues(int count)
+{
+    if (checkPoolState() == true)
+    {
+        std::cerr << "线程池已经在运行, 无法修改注入队列数量!" << std::endl;
+        return;
+    }
+    injectQueSize_ = std::min(std::max(count, 0), INJECT_QUEUE_MAX);
+}
+
+// 设置排队时间准入控制
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::setQueueDelayTarget(std::chrono::nanoseconds target,
+                                                                                         std::chrono::nanoseconds interval)
+{
+    if (checkPoolState() == true)
+    {
+        std::cerr << "线程池已经在运行, 无法修改排队时间目标!" << std::endl;
+        return;
+    }
+    codel_.setTarget(target, interval);
+}
+
+// 设置自动调整线程数
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::setAutoTune(int minThreads, int maxThreads,
+                                                                                 std::chrono::milliseconds period)
+{
+    if (checkPoolState() == true)
+    {
+        std::cerr << "线程池已经在运行, 无法打开自动调整线程数!" << std::endl;
+        return;
+    }
+    tuneMinThreads_ = std::max(1, minThreads);
+    tuneMaxThreads_ = std::max(tuneMinThreads_, maxThreads);
+    tunePeriod_ = period;
+}
+
+// 监视cgroup的CPU配额
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::watchCpuQuota(std::chrono::milliseconds period,
+                                                                                   std::string root)
+{
+    if (checkPoolState() == true)
+    {
+        std::cerr << "线程池已经在运行, 无法监视CPU配额!" << std::endl;
+        return;
+    }
+    quotaPeriod_ = period;
+    quotaRoot_ = std::move(root);
+}
+
+// 设置线程池cached模式线程数量阈值, 用于动态变化线程池模式
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::setThreadSizeThreshHold(int size)
+{
+    if (checkPoolState() == true)
+    {
+        std::cerr << "线程池已经在运行, 无法修改线程池线程数量阈值!" << std::endl;
+        return;
+    }
+    if (Growth::elastic(poolmode_))
+    {
+        ThreadSizeThreshold_ = size; // 设置线程池线程数量阈值
+    }
+    else
+    {
+        std::cerr << "线程池模式不是动态变化线程池, 无法修改线程池线程数量阈值!"
+            << std::endl;
+        return;
+    }
+}
+
+// 提交任务到线程池
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+Result BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::submitTask(std::shared_ptr<Task> sp, CancellationToken token)
+{
+    // 用户任务阻塞不能超过1s
+    return submitTaskFor(std::move(sp), std::move(token), std::chrono::seconds(1));
+}
+
+// 提交任务到线程池, 队列满了马上失败
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+Result BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::trySubmitTask(std::shared_ptr<Task> sp, CancellationToken token)
+{
+    return submitTaskFor(std::move(sp), std::move(token), std::chrono::milliseconds(0));
+}
+
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+Result BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::submitTaskFor(std::shared_ptr<Task> sp,
+                                                                                    CancellationToken token,
+                                                                                    std::chrono::milliseconds wait)
+{
+    sp->pool_ = this;
+    sp->claimed_ = false;
+    sp->cancelState_ = token.state_;
+    POOL_TRACE(TraceEvent::SUBMIT, sp.get());
+    hooks().onSubmit(*sp);
+    sp->queuedBytes_ = sp->footprint();
+    sp->submitNs_ = 0;
+    if (recorder_.enabled())
+    {
+        sp->submitNs_ = recorder_.submitStamp();
+        sp->submitThread_ = WorkloadRecorder::threadIndex();
+    }
+    // 入队前先绑定完成状态, 入队后任务随时可能被执行
+    Result res(sp, true);
+
+    // 工作线程里嵌套提交的任务放到本线程的本地队列
+    // 不等全局队列的空位: 工作线程在这里阻塞可能把整个线程池卡死
+    if (currentPool_ == this)
+    {
+        {
+            // 先计数再放进队列: 放进去以后随时可能被偷走, leaveQueue不能跑在enterQueue前面
+            std::lock_guard<std::mutex> guard(currentLocalQue_->mutex_);
+            enterQueue(sp.get());
+            currentLocalQue_->que_.emplace_back(sp);
+        }
+        POOL_TRACE(TraceEvent::ENQUEUE, sp.get());
+
+        // 有空闲线程才去叫醒它来偷, 先加taskSize_再读idleThreadSize_, 和threadFunc里的顺序相反
+        bool needGrow = needMoreThreads();
+        if (idleThreadSize_ > 0 || helpWaiters_ > 0 || needGrow || needCompensation())
+        {
+            std::unique_lock<std::mutex> lock(taskQueMutex_);
+            notEmpty_.notify_all();
+            if (needGrow && isPoolRunning_)
+            {
+                addThread();
+            }
+            compensateBlocking();
+        }
+        // 入队以后再登记到token上, 已经取消的话马上撤回
+        if (!token.track(sp) && sp->tryClaim())
+        {
+            cancelQueuedTask(sp.get());
+        }
+        return res;
+    }
+
+    // 排队时间持续超标, 马上拒绝, 不让提交者再排1s; 队列空的时候总是接受
+    if (codel_.isEnabled() && taskSize_ > 0 && !codel_.admit(taskSize_))
+    {
+        POOL_LOG("排队时间超过目标, 拒绝任务!");
+        return Result(sp, false);
+    }
+
+    if (injectQueSize_ > 0)
+    {
+        // 先不加锁看名额, 满了才去等notFull_
+        if (taskSize_ >= (size_t)taskQueMaxThreshHold_ || !bytesAdmissible(sp->queuedBytes_))
+        {
+            std::unique_lock<std::mutex> lock(taskQueMutex_);
+            if (!notFull_.wait_for(lock, wait, [&]()->bool
+                {
+                    return taskSize_ < (size_t)taskQueMaxThreshHold_ && bytesAdmissible(sp->queuedBytes_);
+                }))
+            {
+                if (wait.count() > 0)
+                {
+                    std::cerr << "任务提交失败!!" << std::endl;
+                }
+                return Result(sp, false);
+            }
+        }
+
+        // 同一个线程总是进同一个注入队列, 保证它提交的任务按顺序出队
+        LocalQueue& inject = injectQues_[producerIndex() % injectQueSize_];
+        {
+            std::lock_guard<std::mutex> guard(inject.mutex_);
+            inject.que_.emplace_back(sp);
+            enterQueue(sp.get()); // 在锁里计数, 工作线程取走时taskSize_已经加上了
+        }
+        POOL_TRACE(TraceEvent::ENQUEUE, sp.get());
+
+        // 和嵌套提交一样, 有空闲线程或者要扩容才去拿taskQueMutex_
+        bool needGrow = needMoreThreads();
+        if (idleThreadSize_ > 0 || helpWaiters_ > 0 || needGrow || needCompensation())
+        {
+            std::unique_lock<std::mutex> lock(taskQueMutex_);
+            notEmpty_.notify_all();
+            if (needGrow && isPoolRunning_)
+            {
+                addThread();
+            }
+            compensateBlocking();
+        }
+        if (!token.track(sp) && sp->tryClaim())
+        {
+            cancelQueuedTask(sp.get());
+        }
+        return res;
+    }
+
+    // 获取锁
+    std::unique_lock<std::mutex> lock(taskQueMutex_);
+    // 线程通信 等待任务队列有空余
+    // while(taskQue_.size() == TASK_MAX_THRESHOLD)
+    // {
+    //     notFull_.wait(lock); // 等待任务队列不满   条件变量,不要搞混信号量
+    // }
+    // // 优化   lambda条件成立, 会往下走
+    // notFull_.wait(lock,  [&] (){
+    //     return taskQue_.size() < TASK_MAX_THRESHOLD;
+    // });  // 不理解的话可以看一下wait的源码
+    // // 再次优化 用户任务阻塞不能超过1s
+
+    // 用taskSize_而不是taskQue_.size(): 取消的任务还在物理队列里, 但已经不占名额了
+    if (!notFull_.wait_for(lock, wait, [&]()->bool
+        {
+            return taskSize_ < (size_t)taskQueMaxThreshHold_ && bytesAdmissible(sp->queuedBytes_);
+        }))
+    {
+        // 超时了, 任务队列满了; trySubmitTask不等也不打印, 调用方自己处理
+        if (wait.count() > 0)
+        {
+            std::cerr << "任务提交失败!!" << std::endl;
+        }
+
+        // return; // 任务提交失败
+        // return task->getResult(); // 设计细节
+        return Result(sp, false);
+        // Result res(sp, false);
+        // return std::move(res); // 返回结果, 任务提交失败
+    }
+
+    // 有空余 将任务添加到任务队列
+    taskQue_.push(sp);
+    enterQueue(sp.get());
+    POOL_TRACE(TraceEvent::ENQUEUE, sp.get());
+
+    // 通知有任务
+    notEmpty_.notify_all(); // 通知有任务了
+
+    if (needMoreThreads() && isPoolRunning_)
+    {
+        addThread();
+    }
+    compensateBlocking();
+    lock.unlock();
+
+    // 入队以后再登记到token上, 已经取消的话马上撤回
+    if (!token.track(sp) && sp->tryClaim())
+    {
+        cancelQueuedTask(sp.get());
+    }
+
+    return res; // 返回结果, 任务提交成功
+}
+
+// 投递内部任务, 直接进全局队列, 不等空位
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::post(std::shared_ptr<Task> sp)
+{
+    sp->pool_ = this;
+    sp->claimed_ = false;
+    sp->cancelState_ = nullptr;
+    POOL_TRACE(TraceEvent::SUBMIT, sp.get());
+    hooks().onSubmit(*sp);
+    sp->queuedBytes_ = sp->footprint();
+    sp->submitNs_ = 0; // 内部任务不记录
+    Result res(sp, true);
+
+    std::unique_lock<std::mutex> lock(taskQueMutex_);
+    taskQue_.push(sp);
+    enterQueue(sp.get());
+    POOL_TRACE(TraceEvent::ENQUEUE, sp.get());
+    notEmpty_.notify_all();
+    if (needMoreThreads() && isPoolRunning_)
+    {
+        addThread();
+    }
+    compensateBlocking();
+}
+
+// 排队中的任务被取消(已经抢到执行权), 归还队列名额, 完成结果
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::cancelQueuedTask(Task* task)
+{
+    leaveQueue(task, false);
+    task->result_->cancel();
+
+    std::unique_lock<std::mutex> lock(taskQueMutex_);
+    // 取消的任务留在物理队列里等工作线程跳过, 太多的话压缩一次, 尽早释放任务对象
+    if (taskQue_.size() > 2 * taskSize_ + 64)
+    {
+        taskQue_.removeIf([](const std::shared_ptr<Task>& t) -> bool
+            {
+                return t->claimed_;
+            });
+    }
+    notFull_.notify_all(); // 名额空出来了
+    if (helpWaiters_ > 0)
+    {
+        notEmpty_.notify_all(); // 在get()里等的可能就是这个任务
+    }
+}
+
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::wakeHelpers()
+{
+    // 没人在等的时候只是一次原子读
+    if (helpWaiters_ > 0)
+    {
+        std::lock_guard<std::mutex> guard(taskQueMutex_);
+        notEmpty_.notify_all();
+    }
+}
+
+// cached模式下任务比空闲线程多, 并且没到线程数量阈值(阻塞区里的线程不算)
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+bool BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::needMoreThreads() const
+{
+    return Growth::elastic(poolmode_) && taskSize_ > idleThreadSize_ &&
+        currentThreadSize_ - blockingThreadSize_ < ThreadSizeThreshold_;
+}
+
+// 进阻塞区的时候队列可能还是空的, 之后提交的任务也要能拿到补偿线程
+// 先加taskSize_再读blockingThreadSize_, 和enterBlocking里的顺序相反, 两边至少有一边看得到对方
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+bool BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::needCompensation() const
+{
+    return compensateThreadSize_ < blockingThreadSize_ && taskSize_ > idleThreadSize_;
+}
+
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::compensateBlocking()
+{
+    if (isPoolRunning_ && needCompensation())
+    {
+        POOL_LOG("有工作线程在阻塞区, 补偿一个线程...");
+        if (addThread())
+        {
+            ++compensateThreadSize_;
+        }
+    }
+}
+
+// 任务进入队列
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::enterQueue(Task* task)
+{
+    if (codel_.isEnabled())
+    {
+        task->enqueueNs_ = CoDelController::nowNs();
+    }
+    queuedBytes_ += task->queuedBytes_;
+    ++taskSize_;
+}
+
+// 任务离开队列, 扣掉入队时记下的字节数
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::leaveQueue(Task* task, bool dequeued)
+{
+    --taskSize_;
+    queuedBytes_ -= task->queuedBytes_;
+    if (dequeued && codel_.isEnabled())
+    {
+        codel_.onDequeue(std::chrono::nanoseconds(CoDelController::nowNs() - task->enqueueNs_));
+    }
+}
+
+// 按字节的上限, 队列空的时候总是放得下
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+bool BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::bytesAdmissible(size_t bytes) const
+{
+    size_t queued = queuedBytes_;
+    return taskQueMaxBytes_ == 0 || queued == 0 || queued + bytes <= taskQueMaxBytes_;
+}
+
+// 创建并启动一个线程, 调用方持有taskQueMutex_, 注册表满了返回false
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+bool BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::addThread()
+{
+    if (freeSlots_.empty())
+    {
+        POOL_LOG("线程数量已达注册表容量, 不再创建线程...");
+        return false;
+    }
+    POOL_LOG("创建新线程...");
+    // 这里不能使用 线程id,  这是主线程, 打印的都是一样的
+
+    // 线程ID就是槽位下标, 每个线程池都从0开始
+    int threadId = freeSlots_.back();
+    freeSlots_.pop_back();
+    WorkerSlot& slot = workers_[threadId];
+    if (slot.thread_ != nullptr)
+    {
+        // 槽位上次的线程归还槽位后就返回了, 这里join很快
+        slot.thread_->join();
+    }
+    slot.thread_ = std::make_unique<Thread>(
+        std::bind(&BasicThreadPool::threadFunc, this, std::placeholders::_1), threadId);
+    slot.live_ = true;
+
+    slot.thread_->start(); // 启动线程
+
+
+    // 修改线程数量相关
+    currentThreadSize_++; // 线程池当前线程总数量加1
+    idleThreadSize_++; // 空闲线程数量加1
+    return true;
+}
+
+// 当前线程退出前归还自己的槽位, 调用方持有taskQueMutex_, 并且本地队列已经空了
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::releaseSlot(int threadid)
+{
+    workers_[threadid].live_ = false;
+    freeSlots_.push_back(threadid);
+}
+
+// 开启线程池
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::start(int initThreadSize)
+{
+    this->isPoolRunning_ = true; // 线程池开始运行
+    // {
+    std::unique_lock<std::mutex> lock(taskQueMutex_);
+    if (tuneMaxThreads_ > 0)
+    {
+        // 自动调整时初始线程数也在上下限之内, cached模式最多长到调整出来的线程数
+        initThreadSize = std::min(std::max(initThreadSize, tuneMinThreads_), tuneMaxThreads_);
+        ThreadSizeThreshold_ = initThreadSize;
+    }
+    this->initThreadSize_ = initThreadSize;
+
+    if (injectQueSize_ > 0)
+    {
+        injectQues_.reset(new LocalQueue[injectQueSize_]);
+        injectCursor_ = 0;
+    }
+
+    // 注册表容量: cached模式最多长到阈值, 再给每个线程留一个阻塞区补偿线程的位置
+    // 监视配额时线程数最多跟到affinity允许的CPU数
+    int quotaMax = quotaPeriod_.count() > 0 ? CpuQuota::affinityCpus() : 0;
+    workerCapacity_ = 2 * std::max<int>({initThreadSize, (int)ThreadSizeThreshold_, tuneMaxThreads_, quotaMax});
+    workers_.reset(new WorkerSlot[workerCapacity_]);
+    freeSlots_.clear();
+    for (int i = workerCapacity_ - 1; i >= 0; --i)
+    {
+        freeSlots_.push_back(i); // 从0号槽位开始用
+    }
+
+    POOL_LOG(initThreadSize_ << "个线程被创建, 线程池开始运行...");
+
+    // 创建并启动线程, 线程拿到锁之前不会开始取任务
+    for (int i = 0; i < initThreadSize; ++i)
+    {
+        addThread();
+    }
+    if (tuneMaxThreads_ > 0)
+    {
+        tuneThread_ = std::thread(&BasicThreadPool::tuneLoop, this);
+    }
+    if (quotaPeriod_.count() > 0)
+    {
+        quotaWatcher_.reset(new CpuQuotaWatcher(CpuQuota(quotaRoot_), quotaPeriod_,
+            [this](int cpus) { onCpuQuotaChanged(cpus); }));
+    }
+    // }
+
+    // startCond_.notify_all(); // 通知线程池全部启动条件变量
+
+}
+
+// 从本地队列尾部取一个还没被拿走的任务
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+std::shared_ptr<Task> BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::takeLocalTask(LocalQueue* localQue)
+{
+    std::lock_guard<std::mutex> guard(localQue->mutex_);
+    while (!localQue->que_.empty())
+    {
+        std::shared_ptr<Task> task = std::move(localQue->que_.back());
+        localQue->que_.pop_back();
+        if (task->tryClaim())
+        {
+            leaveQueue(task.get());
+            return task;
+        }
+        // 已经被等待它的线程在get()里执行了, 丢掉
+    }
+    return nullptr;
+}
+
+// 从全局队列取, 再从注入队列取, 都取不到就从其他线程的本地队列头部偷, 调用方持有taskQueMutex_
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+std::shared_ptr<Task> BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::takeTask(int threadid, size_t batch)
+{
+    std::shared_ptr<Task> task = takeGlobalTask(threadid, batch);
+    if (task != nullptr)
+    {
+        return task;
+    }
+
+    // 全局队列空了, 从上次停下的地方开始轮流取注入队列, 每个注入队列内部先进先出
+    for (int i = 0; i < injectQueSize_; ++i)
+    {
+        LocalQueue& inject = injectQues_[injectCursor_];
+        injectCursor_ = (injectCursor_ + 1) % injectQueSize_;
+        std::lock_guard<std::mutex> guard(inject.mutex_);
+        while (!inject.que_.empty())
+        {
+            std::shared_ptr<Task> task = std::move(inject.que_.front());
+            inject.que_.pop_front();
+            if (task->tryClaim())
+            {
+                leaveQueue(task.get());
+                if (batch > 1)
+                {
+                    takeBatch(threadid, nullptr, &inject.que_, batch);
+                }
+                return task;
+            }
+        }
+    }
+
+    for (int i = 0; i < workerCapacity_; ++i)
+    {
+        if (i == threadid || !workers_[i].live_)
+        {
+            continue;
+        }
+        LocalQueue* victim = &workers_[i].localQue_;
+        std::lock_guard<std::mutex> guard(victim->mutex_);
+        while (!victim->que_.empty())
+        {
+            std::shared_ptr<Task> task = std::move(victim->que_.front());
+            victim->que_.pop_front();
+            if (task->tryClaim())
+            {
+                leaveQueue(task.get());
+                return task;
+            }
+        }
+    }
+    return nullptr;
+}
+
+// 只从全局队列取, 调用方持有taskQueMutex_
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+std::shared_ptr<Task> BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::takeGlobalTask(int threadid, size_t batch)
+{
+    while (!taskQue_.empty())
+    {
+        std::shared_ptr<Task> task = taskQue_.pop();
+        if (task->tryClaim())
+        {
+            leaveQueue(task.get());
+            if (batch > 1)
+            {
+                takeBatch(threadid, &taskQue_, nullptr, batch);
+            }
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+// 多拿的任务不抢执行权, 还算在排队里, 放进本地队列以后照样可以被偷
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::takeBatch(int threadid, Queue<Allocator>* que,
+                                                                               std::deque<std::shared_ptr<Task>>* inject,
+                                                                               size_t batch)
+{
+    std::shared_ptr<Task> extra[DEQUEUE_BATCH_MAX];
+    size_t n = 0;
+    while (n < batch - 1 && (que != nullptr ? !que->empty() : !inject->empty()))
+    {
+        std::shared_ptr<Task> next;
+        if (que != nullptr)
+        {
+            next = que->pop();
+        }
+        else
+        {
+            next = std::move(inject->front());
+            inject->pop_front();
+        }
+        if (!next->claimed_)
+        {
+            extra[n++] = std::move(next);
+        }
+    }
+    // 本地队列从尾部取, 先出队的放在最后, 保持原来的顺序
+    LocalQueue& localQue = workers_[threadid].localQue_;
+    std::lock_guard<std::mutex> guard(localQue.mutex_);
+    while (n > 0)
+    {
+        localQue.que_.emplace_back(std::move(extra[--n]));
+    }
+}
+
+// 固定数量直接用; 自适应: 任务耗时长的一次一个, 否则按线程平分全局队列, 多拿的不至于饿着别的线程
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+size_t BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::dequeueBatchSize(uint64_t avgTaskNs) const
+{
+    if (dequeueBatch_ > 0)
+    {
+        return dequeueBatch_;
+    }
+    if (avgTaskNs > BATCH_TASK_NS)
+    {
+        return 1;
+    }
+    // 分片时全局队列基本是空的, 按所有排队的任务算
+    size_t queued = injectQueSize_ > 0 ? (size_t)taskSize_ : taskQue_.size();
+    size_t share = queued / std::max<size_t>(1, currentThreadSize_);
+    return std::min<size_t>(DEQUEUE_BATCH_MAX, std::max<size_t>(1, share));
+}
+
+// 工作线程在Result::get()里等待时, 执行其他任务, 优先执行等待的那个
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::help(Task* awaited, Completion* done)
+{
+    std::chrono::milliseconds backoff(1);
+    while (!done->isReady())
+    {
+        // 等待的任务还在队列里, 直接拿过来执行
+        if (awaited->pool_ == this && awaited->tryClaim())
+        {
+            leaveQueue(awaited);
+            POOL_TRACE(TraceEvent::DEQUEUE, awaited);
+            runTask(awaited);
+            continue;
+        }
+
+        // 栈上帮忙执行的任务已经压了HELP_DEPTH_MAX层, 不再执行别的任务, 按阻塞处理, 线程池补偿线程
+        // 等待的任务自己不算: 直接执行它和普通的函数调用一样, 栈的深度由程序自己的递归决定
+        if (helpDepth_ >= HELP_DEPTH_MAX)
+        {
+            blocking_scope blocking;
+            done->wait();
+            break;
+        }
+
+        std::shared_ptr<Task> task = takeLocalTask(currentLocalQue_);
+        if (task == nullptr)
+        {
+            std::unique_lock<std::mutex> lock(taskQueMutex_);
+            task = takeTask(currentThreadId_);
+            if (task != nullptr)
+            {
+                notFull_.notify_all();
+            }
+        }
+
+        if (task != nullptr)
+        {
+            POOL_TRACE(TraceEvent::DEQUEUE, task.get());
+            ++helpDepth_;
+            runTask(task.get());
+            --helpDepth_;
+            backoff = std::chrono::milliseconds(1);
+        }
+        else if (awaited->pool_ == this)
+        {
+            // 等待的任务正在本线程池的别的线程上执行, 也没有别的任务可以帮忙
+            // 睡在notEmpty_上: 有任务入队或者任务执行完(runTask)都会叫醒; 超时只是防止漏掉通知
+            std::unique_lock<std::mutex> lock(taskQueMutex_);
+            ++helpWaiters_;
+            notEmpty_.wait_for(lock, HELP_WAIT_MAX, [&]() -> bool
+                {
+                    return done->isReady() || taskSize_ > 0 || !isPoolRunning_;
+                });
+            --helpWaiters_;
+        }
+        else
+        {
+            // 等的是别的线程池的任务, 它完成时只通知完成状态; 本线程池来了任务要靠醒来看, 醒的间隔逐步加长
+            done->wait_for(backoff);
+            backoff = std::min(backoff * 2, std::chrono::milliseconds(HELP_WAIT_MAX));
+        }
+    }
+}
+
+// 等待的线程帮忙执行一个任务, 不偷别的线程的本地队列: 那些任务多半和别的线程上正在执行的任务有关
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+bool BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::helpOnce()
+{
+    std::shared_ptr<Task> task = takeLocalTask(currentLocalQue_);
+    if (task == nullptr)
+    {
+        std::unique_lock<std::mutex> lock(taskQueMutex_);
+        task = takeGlobalTask(currentThreadId_);
+        if (task == nullptr)
+        {
+            return false;
+        }
+        notFull_.notify_all();
+    }
+    POOL_TRACE(TraceEvent::DEQUEUE, task.get());
+    runTask(task.get());
+    return true;
+}
+
+// 执行一个已经抢到执行权的任务, 前后调用钩子
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::runTask(Task* task)
+{
+    hooks().onStart(*task);
+    POOL_TRACE(TraceEvent::START, task);
+    if (__builtin_expect(task->submitNs_ != 0, 0))
+    {
+        // 记录负载时提交的任务, 量一下执行耗时
+        int64_t begin = WorkloadRecorder::nowNs();
+        task->exec();
+        recorder_.record(task->submitNs_, task->submitThread_, WorkloadRecorder::nowNs() - begin, task->tag_);
+    }
+    else
+    {
+        task->exec(); // 执行任务
+    }
+    if (tuneMaxThreads_ > 0)
+    {
+        completedTasks_.fetch_add(1, std::memory_order_relaxed);
+    }
+    POOL_TRACE(TraceEvent::END, task);
+    hooks().onFinish(*task);
+    wakeHelpers();
+}
+
+// 工作线程进入阻塞区
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::enterBlocking()
+{
+    // 阻塞期间不占用执行组的名额
+    if (holdingGroupSlot_)
+    {
+        releaseGroupSlot();
+    }
+
+    ++blockingThreadSize_;
+    // 还有任务排着, 又没有空闲线程, 补一个线程顶替阻塞的这个
+    if (needCompensation())
+    {
+        std::unique_lock<std::mutex> lock(taskQueMutex_);
+        compensateBlocking();
+    }
+}
+
+// 工作线程离开阻塞区
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::leaveBlocking()
+{
+    --blockingThreadSize_;
+    // 补偿线程比阻塞的线程多了, 多出来的在两个任务之间退出
+    {
+        std::unique_lock<std::mutex> lock(taskQueMutex_);
+        if (compensateThreadSize_ > blockingThreadSize_)
+        {
+            --compensateThreadSize_;
+            ++retireThreadSize_;
+            notEmpty_.notify_all(); // 空闲线程也可以退出
+        }
+    }
+
+    // 继续执行任务之前, 重新拿执行组的名额
+    if (group_ != nullptr && !holdingGroupSlot_)
+    {
+        acquireGroupSlot();
+    }
+}
+
+// 自动调整线程数: 每个周期量一次吞吐量, 交给爬山算法决定下一个周期的线程数
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::tuneLoop()
+{
+    HillClimber climber(tuneMinThreads_, tuneMaxThreads_, initThreadSize_);
+    uint64_t lastCompleted = completedTasks_;
+    auto lastTime = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(tuneMutex_);
+    while (!tuneCond_.wait_for(lock, tunePeriod_, [&]() -> bool { return tuneStop_; }))
+    {
+        auto now = std::chrono::steady_clock::now();
+        uint64_t completed = completedTasks_;
+        double throughput = (completed - lastCompleted) / std::chrono::duration<double>(now - lastTime).count();
+        lastCompleted = completed;
+        lastTime = now;
+
+        int target = climber.update(throughput);
+        int cpus = quotaHint_.exchange(0);
+        if (cpus > 0)
+        {
+            // 配额变了, 之前量的吞吐量不能再比, 从配额对应的线程数重新爬
+            target = climber.reset(cpus);
+        }
+        POOL_LOG("自动调整线程数: 吞吐量 " << throughput << "/s, 线程数调整到 " << target);
+        resizeTo(target);
+    }
+}
+
+// cgroup配额变了: 自动调整时交给自动调整线程从新的值重新爬, 否则直接把线程数调成配额
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::onCpuQuotaChanged(int cpus)
+{
+    POOL_LOG("CPU配额变化, 可用CPU数量: " << cpus);
+    if (tuneMaxThreads_ > 0)
+    {
+        quotaHint_ = cpus;
+    }
+    else
+    {
+        resizeTo(cpus);
+    }
+}
+
+// 调整线程数, 阻塞区的补偿线程和已经在等着退出的线程不算
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::resizeTo(int target)
+{
+    std::unique_lock<std::mutex> lock(taskQueMutex_);
+    if (!isPoolRunning_)
+    {
+        return;
+    }
+    ThreadSizeThreshold_ = target;
+    int current = (int)currentThreadSize_ - (int)compensateThreadSize_ - (int)retireThreadSize_;
+    while (current < target && addThread())
+    {
+        ++current;
+    }
+    if (current > target)
+    {
+        retireThreadSize_ += current - target;
+        notEmpty_.notify_all(); // 空闲线程也可以退出
+    }
+}
+
+// 有待退出的补偿线程的话, 当前线程退出, 返回true
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+bool BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::tryRetire(int threadid, LocalQueue* localQue)
+{
+    std::unique_lock<std::mutex> lock(taskQueMutex_);
+    {
+        // 本地队列还有任务的话先执行完
+        std::lock_guard<std::mutex> guard(localQue->mutex_);
+        if (!localQue->que_.empty())
+        {
+            return false;
+        }
+    }
+    if (retireThreadSize_ == 0)
+    {
+        return false;
+    }
+    retireThread(threadid);
+    return true;
+}
+
+// 回收当前线程, 调用方持有taskQueMutex_, 并且本地队列已经空了
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::retireThread(int threadid)
+{
+    --retireThreadSize_;
+
+    if (holdingGroupSlot_)
+    {
+        releaseGroupSlot();
+    }
+    POOL_LOG("阻塞区已结束, 回收补偿线程...");
+    releaseSlot(threadid);
+    idleThreadSize_--; // 空闲线程数量减1
+    currentThreadSize_--; // 线程池当前线程总数量减1
+    POOL_TRACE(TraceEvent::EXIT, nullptr);
+    hooks().onWorkerExit(threadid);
+}
+
+// 线程池退出, 有任务也得先执行完
+// 定义线程函数
+template <typename Hooks, template <typename> class Queue, typename WaitStrategy, typename Allocator, typename Growth>
+void BasicThreadPool<Hooks, Queue, WaitStrategy, Allocator, Growth>::threadFunc(int threadid)
+{
+
+    auto lastTime = std::chrono::high_resolution_clock::now(); // 记录线程开始时间
+
+    // 注册表在start()里建好以后不再变, 不用加锁
+    LocalQueue* localQue = &workers_[threadid].localQue_;
+    currentPool_ = this;
+    currentLocalQue_ = localQue;
+    currentThreadId_ = threadid;
+    POOL_TRACE(TraceEvent::SPAWN, nullptr);
+    hooks().onWorkerStart(threadid);
+
+    // 加入执行组时, 连续有任务就一直拿着执行名额, 不用每个任务都申请一次
+    // 有别的线程在等名额, 并且已经拿了一个时间片, 才让出去
+    holdingGroupSlot_ = false;
+    auto slotSince = lastTime;
+    uint64_t avgTaskNs = 0; // 这个线程执行任务的平均耗时, 自适应批量用
+
+    // for (;;)
+    for (;;)
+    {
+        // 阻塞区结束后多出来的补偿线程, 在两个任务之间退出
+        if (retireThreadSize_ > 0 && tryRetire(threadid, localQue))
+        {
+            return;
+        }
+
+        // 先执行本线程嵌套提交的任务, 不用碰全局锁
+        std::shared_ptr<Task> task = takeLocalTask(localQue);
+        if (task != nullptr)
+        {
+            POOL_TRACE(TraceEvent::DEQUEUE, task.get());
+            idleThreadSize_--; // 空闲线程数量减1
+            // 本地队列的任务也算在字节上限里, 腾出内存要叫醒等着的提交者
+            if (taskQueMaxBytes_ != 0)
+            {
+                std::lock_guard<std::mutex> guard(taskQueMutex_);
+                notFull_.notify_all();
+            }
+        }
+        else
+        {
+            // 获取锁
+            std::unique_lock<std::mutex> lock(taskQueMutex_);
+
+            POOL_LOG("Thread " << std::this_thread::get_id() << "尝试获取任务...");
+
+            // 区分超时返回和 任务执行返回
+            // 1s返回一次
+            while ((task = takeTask(threadid, dequeueBatchSize(avgTaskNs))) == nullptr)
+            {
+                // 没有任务要睡了, 执行名额还给执行组
+                if (holdingGroupSlot_)
+                {
+                    releaseGroupSlot();
+                }
+                if (!this->isPoolRunning_)
+                {
+                    releaseSlot(threadid);
+                    POOL_LOG("Thread " << std::this_thread::get_id()
+                        << "线程池不在运行状态, 回收线程...");
+                    POOL_TRACE(TraceEvent::EXIT, nullptr);
+                    hooks().onWorkerExit(threadid);
+                    return; // 析构函数在join等着
+
+                }
+                // 有待退出的补偿线程, 空闲的线程直接退出
+                if (retireThreadSize_ > 0)
+                {
+                    retireThread(threadid);
+                    return;
+                }
+                // cached模式下, 空闲时间超过60s, 则回收多余的线程
+                if (Growth::elastic(poolmode_))
+                {
+                    // 条件变量, 超时返回了
+                    POOL_TRACE(TraceEvent::PARK, nullptr);
+                    bool woken = WaitStrategy::waitFor(lock, notEmpty_, std::chrono::seconds(1), [&]()-> bool
+                        {
+                            return taskSize_ > 0 || !isPoolRunning_ || retireThreadSize_ > 0;
+                        });
+                    POOL_TRACE(TraceEvent::UNPARK, nullptr);
+                    if (!woken)
+                    {
+                        auto now = std::chrono::high_resolution_clock::now();
+                        auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - lastTime);
+                        if (duration >= Growth::idleTimeout() && currentThreadSize_ > initThreadSize_)
+                        {
+                            // 回收线程
+                            // 记录线程数量相关的 需要修改
+                            // 把当前线程从线程列表删除--难点: 没有办法匹配 改线程函数 对应哪个 线程对象
+                            POOL_LOG("动态创建的线程, 空闲时间超过10s, 回收线程...");
+                            releaseSlot(threadid); // 本地队列已经是空的, 线程对象留到槽位复用时join
+                            // 不要使用 std::this_thread::get_id() 
+
+                            idleThreadSize_--; // 空闲线程数量减1
+                            currentThreadSize_--; // 线程池当前线程总数量减1
+
+                            POOL_TRACE(TraceEvent::EXIT, nullptr);
+
+                            hooks().onWorkerExit(threadid);
+                            return; // 退出线程函数
+
+                        }
+                    }
+
+                }
+                else   //fixed模式
+                {
+                    // 等待任务队列不空
+                    POOL_TRACE(TraceEvent::PARK, nullptr);
+                    WaitStrategy::wait(lock, notEmpty_, [&]() -> bool
+                        {
+                            return taskSize_ > 0 || !isPoolRunning_ || retireThreadSize_ > 0;
+                        });
+                    POOL_TRACE(TraceEvent::UNPARK, nullptr);
+                }
+
+                // 析构时, 唤醒后, 还是会先走这里
+                // 如果线程池不在运行状态, 则退出线程函数
+                // 析构情况1 : 原本就是等待
+                // 死锁优化
+                // if (!isPoolRunning_)
+                // {
+                //     threads_.erase(threadid); // 删除线程对象
+                //     std::cout << "Thread " << std::this_thread::get_id()
+                //         << "线程池不在运行状态, 回收线程..." << std::endl;
+                //     exitCond_.notify_all(); // 通知线程池退出条件变量
+                //     return;
+                // }
+
+
+            }
+
+
+            POOL_LOG("Thread " << std::this_thread::get_id()
+                << "获取到任务, 开始执行...");
+            POOL_TRACE(TraceEvent::DEQUEUE, task.get());
+
+            idleThreadSize_--; // 空闲线程数量减1
+
+            // -- 复现死锁本人解决办法
+            // startCond_.notify_all();
+
+            // 如果还有任务, 通知其他的线程执行
+            if (taskSize_ > 0)
+            {
+                notEmpty_.notify_all(); // 通知其他线程有任务了
+            }
+
+            // 通知任务队列不满
+            notFull_.notify_all();
+
+            // 解锁
+            // lock.unlock();
+        }
+        // 执行任务
+        if (task != nullptr)
+        {
+            // 加入了执行组的话, 先拿执行名额, 控制整个进程同时执行的任务数量
+            if (group_ != nullptr && !holdingGroupSlot_)
+            {
+                acquireGroupSlot();
+                slotSince = std::chrono::high_resolution_clock::now();
+            }
+            // task->run(); // 执行任务
+            if (dequeueBatch_ == 0)
+            {
+                // 自适应批量要知道任务大概多长, 指数平均
+                auto runBegin = std::chrono::steady_clock::now();
+                runTask(task.get());
+                uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - runBegin).count();
+                avgTaskNs = (avgTaskNs * 7 + ns) / 8;
+            }
+            else
+            {
+                runTask(task.get());
+            }
+            if (holdingGroupSlot_ && groupHasWaiters() &&
+                std::chrono::high_resolution_clock::now() - slotSince >= GROUP_TIME_SLICE)
+            {
+                releaseGroupSlot();
+            }
+        }
+
+        idleThreadSize_++; // 空闲线程数量加1
+
+        // 位置要注意, 这记录的是  任务执行完的时间
+        lastTime = std::chrono::high_resolution_clock::now(); // 更新线程开始时间
+    }
+
+
+
+}
+
+// 默认配置只在threadpool.cc里实例化一次
+extern template class BasicThreadPool<>;
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 任务生命周期事件
+enum class TraceEvent : uint8_t
+{
+    SUBMIT,  // 用户调用submitTask
+    ENQUEUE, // 任务进入队列
+    DEQUEUE, // 工作线程从队列取到任务
+    START,   // 任务开始执行
+    END,     // 任务执行结束
+    PARK,    // 工作线程没有任务, 开始睡眠
+    UNPARK,  // 工作线程被唤醒
+    SPAWN,   // 工作线程创建
+    EXIT,    // 工作线程退出
+};
+
+/*
+**********************************example**************************
+Tracer::start();                       // 打开记录
+... 提交任务 ...
+Tracer::stop();
+Tracer::writeChromeTrace("trace.json"); // 用 ui.perfetto.dev 或 chrome://tracing 打开
+*/
+
+// 任务调度时间线记录器, 默认关闭
+// 每个线程写自己的缓冲区(单写者, 无锁), 写满后丢弃并计数
+// 关闭时埋点只有一次可预测的分支
+class Tracer
+{
+public:
+    // 开始记录, 清空之前的记录; capacityPerThread: 每个线程最多记录多少个事件
+    static void start(size_t capacityPerThread = 1 << 16);
+
+    // 停止记录, 已经记录的事件保留到下一次start()
+    static void stop();
+
+    // 是否正在记录
+    static bool enabled()
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // 记录一个事件, 调用方先检查enabled(), 用POOL_TRACE宏
+    static void record(TraceEvent event, const void *task);
+
+    // 把记录写成Chrome trace-event JSON, Perfetto可以直接打开
+    static bool writeChromeTrace(const std::string &path);
+
+    // 因为缓冲区满丢掉的事件数量
+    static size_t dropped();
+
+private:
+    static std::atomic_bool enabled_;
+};
+
+// 埋点, 关闭时只是一次分支
+#define POOL_TRACE(event, task) \
+    do \
+    { \
+        if (__builtin_expect(Tracer::enabled(), 0)) \
+        { \
+            Tracer::record(event, task); \
+        } \
+    } while (0)
+
+#endif
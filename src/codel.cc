@@ -0,0 +1,79 @@
+#include "codel.h"
+#include <algorithm>
+
+CoDelController::CoDelController()
+    : targetNs_(0)
+    , intervalNs_(0)
+    , intervalEnd_(0)
+    , minDelayNs_(0)
+    , lastMinDelayNs_(0)
+    , shedMark_(0)
+    , dequeued_(0)
+    , nsPerDequeue_(0)
+    , resetting_(false)
+    , overloaded_(false)
+    , shed_(0)
+{}
+
+void CoDelController::setTarget(std::chrono::nanoseconds target, std::chrono::nanoseconds interval)
+{
+    targetNs_ = target.count();
+    intervalNs_ = interval.count();
+    intervalEnd_ = nowNs() + intervalNs_;
+    minDelayNs_ = INT64_MAX;
+    dequeued_ = 0;
+    nsPerDequeue_ = 0;
+    overloaded_ = false;
+}
+
+void CoDelController::onDequeue(std::chrono::nanoseconds delay)
+{
+    int64_t ns = delay.count();
+    int64_t now = nowNs();
+    ++dequeued_;
+    // 区间结束, 只让一个线程来判断, 这个样本算在结束的区间里
+    if (now > intervalEnd_ && !resetting_.exchange(true))
+    {
+        int64_t minDelay = std::min<int64_t>(minDelayNs_, ns);
+        lastMinDelayNs_ = minDelay;
+        // 进入过载看最小值超过目标; 过载期间队列被控制在目标附近, 最小值会低于目标,
+        // 所以退出还要求这个区间一个任务都没拒绝过, 也就是提交的速度已经降下来了
+        uint64_t shed = shed_;
+        bool shedding = shed != shedMark_;
+        shedMark_ = shed;
+        overloaded_ = minDelay > targetNs_ || (overloaded_ && shedding);
+        // 这个区间的出队速度, 估算新任务要排多久
+        nsPerDequeue_ = (now - intervalEnd_ + intervalNs_) / std::max<uint64_t>(1, dequeued_.exchange(0));
+        minDelayNs_ = INT64_MAX;
+        intervalEnd_ = now + intervalNs_;
+        resetting_ = false;
+        return;
+    }
+
+    int64_t cur = minDelayNs_;
+    while (ns < cur && !minDelayNs_.compare_exchange_weak(cur, ns))
+    {
+    }
+}
+
+bool CoDelController::admit(size_t queued)
+{
+    if (!overloaded_)
+    {
+        return true;
+    }
+    // 整整一个区间没有任务出队(比如全部拒绝以后队列空了), 过载的判断已经过时
+    if (nowNs() > intervalEnd_ + intervalNs_)
+    {
+        overloaded_ = false;
+        return true;
+    }
+    // 过载期间按出队速度估算新任务的排队时间, 在目标以内就接受, 队列的排队时间维持在目标附近
+    // 不用最近出队的任务的排队时间: 那是很早以前入队的, 要等积压全部排完才会降下来
+    if ((int64_t)queued * nsPerDequeue_ <= targetNs_)
+    {
+        return true;
+    }
+    ++shed_;
+    return false;
+}
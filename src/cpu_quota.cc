@@ -0,0 +1,191 @@
+#include "cpu_quota.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <sched.h>
+
+namespace
+{
+    // 读dir下的cgroup v2 cpu.max, 文件读不到返回false; 没有限制或者内容不对时cpus为0
+    bool readCpuMax(const std::string& dir, double& cpus)
+    {
+        std::ifstream in(dir + "/cpu.max");
+        std::string quota;
+        double period = 0;
+        if (!(in >> quota >> period))
+        {
+            return false;
+        }
+        // 这个函数在监视线程上调用, 内容不对按没有限制处理, 不抛异常
+        char* end = nullptr;
+        double value = strtod(quota.c_str(), &end);
+        cpus = 0;
+        if (quota != "max" && *end == '\0' && value > 0 && std::isfinite(value) && period > 0)
+        {
+            cpus = value / period;
+        }
+        return true;
+    }
+
+    // 读dir下的cgroup v1 cpu.cfs_quota_us和cpu.cfs_period_us, 配额为-1表示不限制
+    bool readCfsQuota(const std::string& dir, double& cpus)
+    {
+        std::ifstream quotaIn(dir + "/cpu.cfs_quota_us");
+        std::ifstream periodIn(dir + "/cpu.cfs_period_us");
+        long quota = 0;
+        long period = 0;
+        if (!(quotaIn >> quota && periodIn >> period))
+        {
+            return false;
+        }
+        cpus = quota > 0 && period > 0 ? (double)quota / period : 0;
+        return true;
+    }
+
+    // 从path这一层往上到根, 逐级读配额, 取最小的; 一层都读不到返回false
+    template <typename Read>
+    bool readHierarchy(const std::string& root, std::string path, Read read, double& cpus)
+    {
+        bool found = false;
+        cpus = 0;
+        while (true)
+        {
+            double level = 0;
+            if (read(root + path, level))
+            {
+                found = true;
+                if (level > 0 && (cpus == 0 || level < cpus))
+                {
+                    cpus = level;
+                }
+            }
+            if (path.empty())
+            {
+                return found;
+            }
+            path.erase(path.rfind('/'));
+        }
+    }
+
+    // "/"算根, 去掉末尾的'/', 根是空串
+    std::string normalizeCgroupPath(std::string path)
+    {
+        while (!path.empty() && path.back() == '/')
+        {
+            path.pop_back();
+        }
+        return path;
+    }
+}
+
+CpuQuota::CpuQuota(std::string root, const std::string& procCgroup)
+    : root_(std::move(root))
+{
+    // v2: "0::/user.slice/app.service"; v1: "4:cpu,cpuacct:/docker/abc"
+    std::ifstream in(procCgroup);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        size_t first = line.find(':');
+        size_t second = first == std::string::npos ? first : line.find(':', first + 1);
+        if (second == std::string::npos || line.compare(second + 1, 1, "/") != 0)
+        {
+            continue;
+        }
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        std::string path = normalizeCgroupPath(line.substr(second + 1));
+        if (controllers.empty())
+        {
+            v2Path_ = path;
+            continue;
+        }
+        std::istringstream list(controllers);
+        std::string controller;
+        while (std::getline(list, controller, ','))
+        {
+            if (controller == "cpu")
+            {
+                v1Path_ = path;
+            }
+        }
+    }
+}
+
+int CpuQuota::available() const
+{
+    int cpus = affinityCpus();
+    double quota = quotaCpus();
+    if (quota > 0)
+    {
+        // 1.5个CPU的配额开2个线程才用得满, 向上取整; 节流靠cgroup自己
+        cpus = std::min(cpus, std::max(1, (int)std::ceil(quota)));
+    }
+    return std::max(1, cpus);
+}
+
+double CpuQuota::quotaCpus() const
+{
+    // cgroup v2: "max 100000" 或者 "400000 100000"; 读到了v2的文件就不再看v1
+    double cpus = 0;
+    if (readHierarchy(root_, v2Path_, readCpuMax, cpus))
+    {
+        return cpus;
+    }
+
+    // cgroup v1: cpu控制器单独挂载, 或者和cpuacct挂在一起
+    for (const char* dir : {"/cpu", "/cpu,cpuacct", "/cpuacct,cpu"})
+    {
+        if (readHierarchy(root_ + dir, v1Path_, readCfsQuota, cpus))
+        {
+            return cpus;
+        }
+    }
+    return 0;
+}
+
+int CpuQuota::affinityCpus()
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        return std::max(1, CPU_COUNT(&set));
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+CpuQuotaWatcher::CpuQuotaWatcher(CpuQuota quota, std::chrono::milliseconds period, std::function<void(int)> onChange)
+    : quota_(std::move(quota))
+    , period_(period)
+    , onChange_(std::move(onChange))
+    , current_(quota_.available())
+    , stop_(false)
+{
+    thread_ = std::thread(&CpuQuotaWatcher::loop, this);
+}
+
+CpuQuotaWatcher::~CpuQuotaWatcher()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+}
+
+void CpuQuotaWatcher::loop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cond_.wait_for(lock, period_, [&]() -> bool { return stop_; }))
+    {
+        int cpus = quota_.available();
+        if (cpus != current_)
+        {
+            current_ = cpus;
+            onChange_(cpus);
+        }
+    }
+}
@@ -0,0 +1,134 @@
+#include "executor_group.h"
+#include <stdexcept>
+
+ExecutorGroup::ExecutorGroup(int budget)
+    : budget_(budget > 0 ? budget : 1)
+    , reserved_(0)
+    , running_(0)
+    , waiters_(0)
+    , nextWake_(0)
+{}
+
+ExecutorGroup::~ExecutorGroup()
+{
+    // 线程池析构会等所有任务执行完, 这期间还要用到本组的名额
+    slots_.clear();
+}
+
+ThreadPool& ExecutorGroup::addPool(const std::string& name, int minConcurrency)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (findSlot(name) != nullptr)
+    {
+        throw std::invalid_argument("executor group already has pool: " + name);
+    }
+    if (minConcurrency < 0 || reserved_ + minConcurrency > budget_)
+    {
+        throw std::invalid_argument("executor group min concurrency exceeds budget");
+    }
+
+    auto slot = std::make_unique<ExecutorSlot>();
+    slot->name_ = name;
+    slot->minConcurrency_ = minConcurrency;
+    slot->active_ = 0;
+    slot->waiters_ = 0;
+    slot->pool_ = std::make_unique<ThreadPool>();
+    slot->pool_->group_ = this;
+    slot->pool_->groupSlot_ = slot.get();
+
+    reserved_ += minConcurrency;
+    slots_.emplace_back(std::move(slot));
+    return *slots_.back()->pool_;
+}
+
+ThreadPool& ExecutorGroup::getPool(const std::string& name)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    ExecutorSlot* slot = findSlot(name);
+    if (slot == nullptr)
+    {
+        throw std::out_of_range("executor group has no pool: " + name);
+    }
+    return *slot->pool_;
+}
+
+int ExecutorGroup::running()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return running_;
+}
+
+int ExecutorGroup::running(const std::string& name)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    ExecutorSlot* slot = findSlot(name);
+    return slot == nullptr ? 0 : slot->active_;
+}
+
+void ExecutorGroup::acquire(ExecutorSlot* slot)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    // 低于保证数量直接执行(可能暂时超出预算, 借出去的名额还回来后就恢复了)
+    // 否则只能借全局预算里空着的
+    if (!(slot->active_ < slot->minConcurrency_ || running_ < budget_))
+    {
+        ++waiters_;
+        ++slot->waiters_;
+        slot->cond_.wait(lock, [&]() -> bool
+            {
+                return slot->active_ < slot->minConcurrency_ || running_ < budget_;
+            });
+        --slot->waiters_;
+        --waiters_;
+    }
+    ++slot->active_;
+    ++running_;
+}
+
+void ExecutorGroup::release(ExecutorSlot* slot)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    --slot->active_;
+    --running_;
+    if (waiters_ > 0)
+    {
+        wakeOne(slot);
+    }
+}
+
+void ExecutorGroup::wakeOne(ExecutorSlot* released)
+{
+    // 释放的池低于保证数量, 它自己的等待者优先
+    if (released->active_ < released->minConcurrency_ && released->waiters_ > 0)
+    {
+        released->cond_.notify_one();
+        return;
+    }
+    if (running_ >= budget_)
+    {
+        return;
+    }
+    // 全局预算有空, 轮流借给有等待者的池
+    for (size_t i = 0; i < slots_.size(); ++i)
+    {
+        ExecutorSlot* slot = slots_[(nextWake_ + i) % slots_.size()].get();
+        if (slot->waiters_ > 0)
+        {
+            nextWake_ = (nextWake_ + i + 1) % slots_.size();
+            slot->cond_.notify_one();
+            return;
+        }
+    }
+}
+
+ExecutorSlot* ExecutorGroup::findSlot(const std::string& name)
+{
+    for (auto& slot : slots_)
+    {
+        if (slot->name_ == name)
+        {
+            return slot.get();
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,400 @@
+#include "fiber.h"
+#include "tracer.h"
+#include <stdexcept>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// 一个纤程
+struct Fiber
+{
+    ucontext_t ctx_;             // 挂起时保存的上下文
+    void *stack_;                // 栈, 从FiberStackPool取的
+    std::shared_ptr<Task> task_; // 要执行的任务
+    FiberPool *pool_;            // 所属的纤程池, 唤醒时放回它的就绪队列
+    bool finished_;              // 任务执行完了, 切回工作线程后回收
+};
+
+// 工作线程的调度状态
+struct FiberWorker
+{
+    ucontext_t ctx_;             // 工作线程自己的上下文, 纤程挂起时切回这里
+    Fiber *current_;             // 正在执行的纤程
+    std::mutex *pendingUnlock_;  // 纤程切走以后要解开的锁
+};
+
+static thread_local FiberWorker *tlsWorker = nullptr;
+
+// 纤程挂起后可能在别的工作线程上恢复, 编译器不能把线程局部变量的地址缓存在切换前后
+// 所以每次都通过一个不内联的函数重新取
+__attribute__((noinline)) static FiberWorker *currentWorker()
+{
+    return tlsWorker;
+}
+
+// **************************FiberStackPool实现*****************************
+FiberStackPool::FiberStackPool(size_t stackSize, size_t maxCached)
+    : pageSize_(sysconf(_SC_PAGESIZE))
+    , maxCached_(maxCached)
+{
+    stackSize_ = (stackSize + pageSize_ - 1) / pageSize_ * pageSize_;
+}
+
+FiberStackPool::~FiberStackPool()
+{
+    for (void *stack : free_)
+    {
+        munmap(static_cast<char *>(stack) - pageSize_, stackSize_ + pageSize_);
+    }
+}
+
+void *FiberStackPool::allocate()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (!free_.empty())
+        {
+            void *stack = free_.back();
+            free_.pop_back();
+            return stack;
+        }
+    }
+
+    // 只保留地址空间, 不预留交换空间, 没碰过的页不占内存
+    void *base = mmap(nullptr, stackSize_ + pageSize_, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (base == MAP_FAILED)
+    {
+        throw std::bad_alloc();
+    }
+    // 栈向低地址增长, 保护页放在最低处
+    if (mprotect(base, pageSize_, PROT_NONE) != 0)
+    {
+        munmap(base, stackSize_ + pageSize_);
+        throw std::bad_alloc();
+    }
+    return static_cast<char *>(base) + pageSize_;
+}
+
+void FiberStackPool::release(void *stack)
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (free_.size() < maxCached_)
+        {
+            free_.push_back(stack);
+            return;
+        }
+    }
+    munmap(static_cast<char *>(stack) - pageSize_, stackSize_ + pageSize_);
+}
+
+// **************************FiberPool实现*****************************
+FiberPool::FiberPool(size_t stackSize)
+    : stacks_(stackSize)
+    , isStopping_(false)
+    , fiberSize_(0)
+{}
+
+FiberPool::~FiberPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        isStopping_ = true;
+        readyCond_.notify_all();
+    }
+    for (auto &t : workers_)
+    {
+        t.join();
+    }
+}
+
+void FiberPool::start(int threadSize)
+{
+    for (int i = 0; i < threadSize; ++i)
+    {
+        workers_.emplace_back(&FiberPool::workerFunc, this);
+    }
+}
+
+Result FiberPool::submitTask(std::shared_ptr<Task> sp)
+{
+    POOL_TRACE(TraceEvent::SUBMIT, sp.get());
+    // 入队前先绑定完成状态, 入队后任务随时可能被执行
+    Result res(sp, true);
+
+    Fiber *fiber = new Fiber();
+    fiber->stack_ = stacks_.allocate();
+    fiber->task_ = std::move(sp);
+    fiber->pool_ = this;
+    fiber->finished_ = false;
+
+    getcontext(&fiber->ctx_);
+    fiber->ctx_.uc_stack.ss_sp = fiber->stack_;
+    fiber->ctx_.uc_stack.ss_size = stacks_.stackSize();
+    fiber->ctx_.uc_link = nullptr; // 入口函数不返回, 结束时自己切回工作线程
+    makecontext(&fiber->ctx_, &FiberPool::fiberEntry, 0);
+
+    ++fiberSize_;
+    POOL_TRACE(TraceEvent::ENQUEUE, fiber->task_.get());
+    schedule(fiber);
+    return res;
+}
+
+bool FiberPool::inFiber()
+{
+    return currentFiber() != nullptr;
+}
+
+Fiber *FiberPool::currentFiber()
+{
+    FiberWorker *worker = currentWorker();
+    return worker != nullptr ? worker->current_ : nullptr;
+}
+
+void FiberPool::yield()
+{
+    Fiber *self = currentFiber();
+    if (self == nullptr)
+    {
+        std::this_thread::yield();
+        return;
+    }
+    FiberPool *pool = self->pool_;
+    pool->mutex_.lock();
+    pool->ready_.push_back(self);
+    suspend(&pool->mutex_);
+}
+
+void FiberPool::sleepFor(std::chrono::nanoseconds duration)
+{
+    Fiber *self = currentFiber();
+    if (self == nullptr)
+    {
+        std::this_thread::sleep_for(duration);
+        return;
+    }
+    FiberPool *pool = self->pool_;
+    auto deadline = Clock::now() + duration;
+    pool->mutex_.lock();
+    bool earliest = pool->timers_.empty() || deadline < pool->timers_.top().first;
+    pool->timers_.emplace(deadline, self);
+    if (earliest)
+    {
+        // 睡着的工作线程可能在等一个更晚的时刻
+        pool->readyCond_.notify_one();
+    }
+    suspend(&pool->mutex_);
+}
+
+void FiberPool::schedule(Fiber *fiber)
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    ready_.push_back(fiber);
+    readyCond_.notify_one();
+}
+
+void FiberPool::suspend(std::mutex *release)
+{
+    FiberWorker *worker = currentWorker();
+    Fiber *self = worker->current_;
+    worker->pendingUnlock_ = release;
+    swapcontext(&self->ctx_, &worker->ctx_);
+    // 被唤醒了, 可能已经换了一个工作线程, 不能再用worker
+}
+
+void FiberPool::fiberEntry()
+{
+    Fiber *self = currentFiber();
+    POOL_TRACE(TraceEvent::START, self->task_.get());
+    self->task_->exec();
+    POOL_TRACE(TraceEvent::END, self->task_.get());
+    self->task_.reset();
+    self->finished_ = true;
+    suspend(nullptr); // 不会再回来
+}
+
+void FiberPool::workerFunc()
+{
+    FiberWorker worker;
+    worker.current_ = nullptr;
+    worker.pendingUnlock_ = nullptr;
+    tlsWorker = &worker;
+    POOL_TRACE(TraceEvent::SPAWN, nullptr);
+
+    for (;;)
+    {
+        Fiber *fiber = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (;;)
+            {
+                // 到点的睡眠纤程放进就绪队列
+                auto now = Clock::now();
+                while (!timers_.empty() && timers_.top().first <= now)
+                {
+                    ready_.push_back(timers_.top().second);
+                    timers_.pop();
+                }
+                if (!ready_.empty())
+                {
+                    fiber = ready_.front();
+                    ready_.pop_front();
+                    break;
+                }
+                if (isStopping_ && fiberSize_ == 0)
+                {
+                    POOL_TRACE(TraceEvent::EXIT, nullptr);
+                    tlsWorker = nullptr;
+                    return;
+                }
+                POOL_TRACE(TraceEvent::PARK, nullptr);
+                if (timers_.empty())
+                {
+                    readyCond_.wait(lock);
+                }
+                else
+                {
+                    // 拷贝一份, 等待期间堆会变
+                    Clock::time_point deadline = timers_.top().first;
+                    readyCond_.wait_until(lock, deadline);
+                }
+                POOL_TRACE(TraceEvent::UNPARK, nullptr);
+            }
+        }
+
+        // 切到纤程, 纤程挂起或者结束时切回来
+        worker.current_ = fiber;
+        swapcontext(&worker.ctx_, &fiber->ctx_);
+        worker.current_ = nullptr;
+
+        // 纤程已经完整地保存了上下文, 现在别的线程可以唤醒它了
+        // 解锁以后纤程随时可能在别的线程上跑完并被回收, 先把状态读出来
+        bool finished = fiber->finished_;
+        if (worker.pendingUnlock_ != nullptr)
+        {
+            worker.pendingUnlock_->unlock();
+            worker.pendingUnlock_ = nullptr;
+        }
+
+        if (finished)
+        {
+            stacks_.release(fiber->stack_);
+            delete fiber;
+            std::lock_guard<std::mutex> guard(mutex_);
+            if (--fiberSize_ == 0 && isStopping_)
+            {
+                readyCond_.notify_all();
+            }
+        }
+    }
+}
+
+// **************************FiberMutex实现*****************************
+void FiberMutex::lock()
+{
+    std::unique_lock<std::mutex> guard(guard_);
+    if (!locked_)
+    {
+        locked_ = true;
+        return;
+    }
+
+    Fiber *self = FiberPool::currentFiber();
+    if (self == nullptr)
+    {
+        // 不在纤程里, 只能让出系统线程重试
+        while (locked_)
+        {
+            guard.unlock();
+            std::this_thread::yield();
+            guard.lock();
+        }
+        locked_ = true;
+        return;
+    }
+
+    // 挂起, 解锁的一方把锁直接交给我们, 醒来时已经持有锁
+    waiters_.push_back(self);
+    guard.release();
+    FiberPool::suspend(&guard_);
+}
+
+bool FiberMutex::try_lock()
+{
+    std::lock_guard<std::mutex> guard(guard_);
+    if (locked_)
+    {
+        return false;
+    }
+    locked_ = true;
+    return true;
+}
+
+void FiberMutex::unlock()
+{
+    Fiber *next = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(guard_);
+        if (waiters_.empty())
+        {
+            locked_ = false;
+        }
+        else
+        {
+            // locked_保持true, 锁交给等待最久的纤程
+            next = waiters_.front();
+            waiters_.pop_front();
+        }
+    }
+    if (next != nullptr)
+    {
+        next->pool_->schedule(next);
+    }
+}
+
+// **************************FiberCondition实现*****************************
+void FiberCondition::wait(std::unique_lock<FiberMutex> &lock)
+{
+    Fiber *self = FiberPool::currentFiber();
+    if (self == nullptr)
+    {
+        throw std::logic_error("FiberCondition::wait() called outside a fiber");
+    }
+    // 先登记再放开用户的锁, 中间的通知不会丢
+    guard_.lock();
+    waiters_.push_back(self);
+    lock.unlock();
+    FiberPool::suspend(&guard_);
+    lock.lock();
+}
+
+void FiberCondition::notify_one()
+{
+    Fiber *next = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(guard_);
+        if (!waiters_.empty())
+        {
+            next = waiters_.front();
+            waiters_.pop_front();
+        }
+    }
+    if (next != nullptr)
+    {
+        next->pool_->schedule(next);
+    }
+}
+
+void FiberCondition::notify_all()
+{
+    std::deque<Fiber *> waiters;
+    {
+        std::lock_guard<std::mutex> guard(guard_);
+        waiters.swap(waiters_);
+    }
+    for (Fiber *fiber : waiters)
+    {
+        fiber->pool_->schedule(fiber);
+    }
+}
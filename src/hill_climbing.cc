@@ -0,0 +1,54 @@
+#include "hill_climbing.h"
+#include <algorithm>
+
+namespace
+{
+    // 吞吐量变化在这个比例以内算噪声
+    const double THROUGHPUT_NOISE = 0.05;
+}
+
+HillClimber::HillClimber(int minThreads, int maxThreads, int initThreads)
+    : minThreads_(std::max(1, minThreads))
+    , maxThreads_(std::max(minThreads_, maxThreads))
+    , current_(std::min(std::max(initThreads, minThreads_), maxThreads_))
+    , direction_(1)
+    , lastThroughput_(-1)
+{}
+
+int HillClimber::update(double throughput)
+{
+    if (lastThroughput_ >= 0)
+    {
+        double change = lastThroughput_ > 0
+            ? (throughput - lastThroughput_) / lastThroughput_
+            : (throughput > 0 ? 1 : 0);
+        if (change < -THROUGHPUT_NOISE)
+        {
+            direction_ = -direction_; // 变差了, 退回去
+        }
+        else if (change <= THROUGHPUT_NOISE)
+        {
+            direction_ = -1;          // 没有变化, 省一个线程
+        }
+        // 变好了就沿原方向继续
+    }
+    lastThroughput_ = throughput;
+
+    int next = current_ + direction_;
+    if (next < minThreads_ || next > maxThreads_)
+    {
+        // 到边界了, 往回试
+        direction_ = -direction_;
+        next = current_ + direction_;
+    }
+    current_ = std::min(std::max(next, minThreads_), maxThreads_);
+    return current_;
+}
+
+int HillClimber::reset(int threads)
+{
+    current_ = std::min(std::max(threads, minThreads_), maxThreads_);
+    direction_ = 1;
+    lastThroughput_ = -1;
+    return current_;
+}
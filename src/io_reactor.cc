@@ -0,0 +1,332 @@
+#include "io_reactor.h"
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+// 在线程池上执行I/O回调的任务
+class IoCallbackTask : public Task
+{
+public:
+    IoCallbackTask(IoReactor::IoCallback cb, ssize_t res)
+        : cb_(std::move(cb)), res_(res) {}
+
+    Any run() override
+    {
+        cb_(res_);
+        return 0;
+    }
+
+private:
+    IoReactor::IoCallback cb_;
+    ssize_t res_;
+};
+
+static void setNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0 && !(flags & O_NONBLOCK))
+    {
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+}
+
+IoReactor::IoReactor(ThreadPoolBase& pool)
+    : pool_(pool)
+    , epollFd_(epoll_create1(EPOLL_CLOEXEC))
+    , wakeFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , isRunning_(true)
+    , pendingSize_(0)
+{
+    if (epollFd_ < 0 || wakeFd_ < 0)
+    {
+        throw std::runtime_error(std::string("IoReactor: ") + strerror(errno));
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeFd_;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev);
+    thread_ = std::thread(&IoReactor::loop, this);
+}
+
+IoReactor::~IoReactor()
+{
+    stop();
+    close(wakeFd_);
+    close(epollFd_);
+}
+
+void IoReactor::asyncRead(int fd, void* buf, size_t len, IoCallback cb)
+{
+    submitOp(fd, IoOp{OpType::READ, buf, len, std::move(cb)});
+}
+
+void IoReactor::asyncWrite(int fd, const void* buf, size_t len, IoCallback cb)
+{
+    submitOp(fd, IoOp{OpType::WRITE, const_cast<void*>(buf), len, std::move(cb)});
+}
+
+void IoReactor::asyncAccept(int fd, IoCallback cb)
+{
+    submitOp(fd, IoOp{OpType::ACCEPT, nullptr, 0, std::move(cb)});
+}
+
+void IoReactor::waitReadable(int fd, IoCallback cb)
+{
+    submitOp(fd, IoOp{OpType::READABLE, nullptr, 0, std::move(cb)});
+}
+
+void IoReactor::waitWritable(int fd, IoCallback cb)
+{
+    submitOp(fd, IoOp{OpType::WRITABLE, nullptr, 0, std::move(cb)});
+}
+
+void IoReactor::submitOp(int fd, IoOp op)
+{
+    std::vector<DoneOp> done;
+    if (!isRunning_)
+    {
+        done.emplace_back(std::move(op), -ECANCELED);
+        complete(done);
+        return;
+    }
+    setNonBlocking(fd);
+
+    ++pendingSize_;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        FdState& state = fds_[fd];
+        bool isRead = op.type_ == OpType::READ || op.type_ == OpType::ACCEPT || op.type_ == OpType::READABLE;
+        std::deque<IoOp>& ops = isRead ? state.readers_ : state.writers_;
+        ops.push_back(std::move(op));
+        // 前面没有排队的话先直接试一次, 大多数时候不用经过epoll
+        if (ops.size() == 1)
+        {
+            drain(fd, ops, false, done);
+        }
+        updateInterest(fd, state, done);
+    }
+    complete(done);
+}
+
+bool IoReactor::perform(int fd, IoOp& op, ssize_t& res)
+{
+    switch (op.type_)
+    {
+    case OpType::READ:
+        res = read(fd, op.buf_, op.len_);
+        break;
+    case OpType::WRITE:
+        res = write(fd, op.buf_, op.len_);
+        break;
+    case OpType::ACCEPT:
+        res = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        break;
+    case OpType::READABLE:
+    case OpType::WRITABLE:
+        // 能走到这里说明已经就绪
+        res = 0;
+        return true;
+    }
+    if (res < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return false;
+        }
+        if (errno == EINTR)
+        {
+            return perform(fd, op, res);
+        }
+        res = -errno;
+    }
+    return true;
+}
+
+void IoReactor::drain(int fd, std::deque<IoOp>& ops, bool ready, std::vector<DoneOp>& done)
+{
+    while (!ops.empty())
+    {
+        IoOp& op = ops.front();
+        ssize_t res = 0;
+        if (op.type_ == OpType::READABLE || op.type_ == OpType::WRITABLE)
+        {
+            // 就绪等待只能由epoll的通知完成
+            if (!ready)
+            {
+                break;
+            }
+        }
+        else if (!perform(fd, op, res))
+        {
+            break;
+        }
+        done.emplace_back(std::move(op), res);
+        ops.pop_front();
+    }
+}
+
+void IoReactor::updateInterest(int fd, FdState& state, std::vector<DoneOp>& done)
+{
+    uint32_t want = (state.readers_.empty() ? 0u : (uint32_t)EPOLLIN) | (state.writers_.empty() ? 0u : (uint32_t)EPOLLOUT);
+    if (want == state.events_)
+    {
+        if (want == 0)
+        {
+            fds_.erase(fd);
+        }
+        return;
+    }
+    if (want == 0)
+    {
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+        fds_.erase(fd);
+        return;
+    }
+
+    epoll_event ev{};
+    ev.events = want;
+    ev.data.fd = fd;
+    int op = state.events_ == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (epoll_ctl(epollFd_, op, fd, &ev) == 0)
+    {
+        state.events_ = want;
+        return;
+    }
+
+    // 登记不了: 普通文件(EPERM)总是就绪, 操作直接完成; 其他错误以-errno结束
+    int err = errno;
+    for (std::deque<IoOp>* ops : {&state.readers_, &state.writers_})
+    {
+        for (IoOp& pending : *ops)
+        {
+            ssize_t res = -err;
+            if (err == EPERM)
+            {
+                perform(fd, pending, res);
+            }
+            done.emplace_back(std::move(pending), res);
+        }
+        ops->clear();
+    }
+    if (state.events_ != 0)
+    {
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+    }
+    fds_.erase(fd);
+}
+
+void IoReactor::complete(std::vector<DoneOp>& done)
+{
+    for (DoneOp& c : done)
+    {
+        --pendingSize_;
+        pool_.post(std::make_shared<IoCallbackTask>(std::move(c.first.cb_), c.second));
+    }
+    done.clear();
+}
+
+void IoReactor::cancel(int fd)
+{
+    std::vector<DoneOp> done;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        auto it = fds_.find(fd);
+        if (it == fds_.end())
+        {
+            return;
+        }
+        for (std::deque<IoOp>* ops : {&it->second.readers_, &it->second.writers_})
+        {
+            for (IoOp& op : *ops)
+            {
+                done.emplace_back(std::move(op), -ECANCELED);
+            }
+        }
+        if (it->second.events_ != 0)
+        {
+            epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+        }
+        fds_.erase(it);
+    }
+    complete(done);
+}
+
+void IoReactor::stop()
+{
+    if (!isRunning_.exchange(false))
+    {
+        return;
+    }
+    uint64_t one = 1;
+    ssize_t n = write(wakeFd_, &one, sizeof(one));
+    (void)n;
+    thread_.join();
+
+    // 剩下的操作都取消
+    std::vector<int> fds;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        for (auto& entry : fds_)
+        {
+            fds.push_back(entry.first);
+        }
+    }
+    for (int fd : fds)
+    {
+        cancel(fd);
+    }
+}
+
+void IoReactor::loop()
+{
+    const int MAX_EVENTS = 256;
+    epoll_event events[MAX_EVENTS];
+    std::vector<DoneOp> done;
+    while (isRunning_)
+    {
+        int n = epoll_wait(epollFd_, events, MAX_EVENTS, -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::cerr << "IoReactor: epoll_wait失败: " << strerror(errno) << std::endl;
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            for (int i = 0; i < n; ++i)
+            {
+                int fd = events[i].data.fd;
+                if (fd == wakeFd_)
+                {
+                    continue;
+                }
+                auto it = fds_.find(fd);
+                if (it == fds_.end())
+                {
+                    continue;
+                }
+                FdState& state = it->second;
+                // 出错或者挂断时两个方向都去试, 系统调用会返回具体的结果
+                uint32_t ev = events[i].events;
+                if (ev & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                {
+                    drain(fd, state.readers_, true, done);
+                }
+                if (ev & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+                {
+                    drain(fd, state.writers_, true, done);
+                }
+                updateInterest(fd, state, done);
+            }
+        }
+        complete(done);
+    }
+}
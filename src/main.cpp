@@ -24,7 +24,11 @@ public:
     Any run() override
     {
         std::cout << "任务开始--thread: " << std::this_thread::get_id() << std::endl;
-        std::this_thread::sleep_for(std::chrono::seconds(3));
+        {
+            // 阻塞期间线程池可以补偿一个线程执行别的任务
+            ThreadPool::blocking_scope blocking;
+            std::this_thread::sleep_for(std::chrono::seconds(3));
+        }
 
         uLong sum = 0;
         for (uLong i = a_; i <= b_; ++i)
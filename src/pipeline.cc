@@ -0,0 +1,244 @@
+#include "pipeline.h"
+#include <iostream>
+
+// 流水线的任务: 带着一个交接过来的数据(可以没有), 之后从源头取数据
+class PipelineTask : public Task
+{
+public:
+    PipelineTask(Pipeline* pipeline, Pipeline::Item* item)
+        : pipeline_(pipeline), hasItem_(item != nullptr)
+    {
+        if (item != nullptr)
+        {
+            item_ = std::move(*item);
+        }
+    }
+
+    Any run() override
+    {
+        pipeline_->work(hasItem_ ? &item_ : nullptr);
+        return 0;
+    }
+
+private:
+    Pipeline* pipeline_;
+    Pipeline::Item item_;
+    bool hasItem_;
+};
+
+Pipeline::Pipeline()
+    : sourceSeq_(0)
+    , sourceDone_(false)
+    , maxTokens_(1)
+    , inFlight_(0)
+    , liveTasks_(0)
+{}
+
+void Pipeline::setSource(SourceFunc source)
+{
+    source_ = std::move(source);
+}
+
+void Pipeline::addStage(StageMode mode, StageFunc fn)
+{
+    std::unique_ptr<Stage> stage(new Stage);
+    stage->mode_ = mode;
+    stage->fn_ = std::move(fn);
+    stages_.push_back(std::move(stage));
+}
+
+void Pipeline::runImpl(size_t maxTokens)
+{
+    if (!source_)
+    {
+        std::cerr << "流水线没有设置源头!" << std::endl;
+        return;
+    }
+    maxTokens_ = std::max<size_t>(1, maxTokens);
+    sourceSeq_ = 0;
+    sourceDone_ = false;
+    inFlight_ = 0;
+    error_ = nullptr;
+    for (auto& stage : stages_)
+    {
+        stage->busy_ = false;
+        stage->nextSeq_ = 0;
+    }
+
+    // 在工作线程里调用时, 等待期间让线程池补偿一个线程
+    ThreadPoolBase::blocking_scope blocking;
+    spawn(nullptr);
+
+    std::unique_lock<std::mutex> lock(doneMutex_);
+    doneCond_.wait(lock, [&]() -> bool { return liveTasks_ == 0; });
+    if (error_)
+    {
+        std::exception_ptr error = error_;
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void Pipeline::work(Item* item)
+{
+    if (item != nullptr)
+    {
+        advance(std::move(*item));
+    }
+    Item next;
+    while (fetch(next))
+    {
+        advance(std::move(next));
+        next = Item();
+    }
+    taskExit();
+}
+
+bool Pipeline::fetch(Item& item)
+{
+    // 源头忙的话不等, 正在取的任务取完会再叫一个任务来
+    std::unique_lock<std::mutex> lock(sourceMutex_, std::try_to_lock);
+    if (!lock.owns_lock() || sourceDone_ || inFlight_ >= maxTokens_)
+    {
+        return false;
+    }
+
+    bool produced = false;
+    try
+    {
+        produced = source_(item.value_);
+    }
+    catch (...)
+    {
+        setError(std::current_exception());
+    }
+    if (!produced)
+    {
+        sourceDone_ = true;
+        return false;
+    }
+    item.seq_ = sourceSeq_++;
+    bool more = ++inFlight_ < maxTokens_;
+    lock.unlock();
+
+    // 还有令牌, 叫一个任务接着取, 这个任务带着数据往下走
+    if (more)
+    {
+        spawn(nullptr);
+    }
+    return true;
+}
+
+void Pipeline::advance(Item item)
+{
+    for (; item.stage_ < stages_.size(); ++item.stage_)
+    {
+        Stage& stage = *stages_[item.stage_];
+        bool serial = stage.mode_ != StageMode::PARALLEL;
+        if (serial && !item.ownsStage_)
+        {
+            std::lock_guard<std::mutex> guard(stage.mutex_);
+            bool turn = !stage.busy_
+                && (stage.mode_ == StageMode::SERIAL_OUT_OF_ORDER || item.seq_ == stage.nextSeq_);
+            if (!turn)
+            {
+                // 没轮到, 留在缓冲里, 由处理完的那个任务交接
+                if (stage.mode_ == StageMode::SERIAL_IN_ORDER)
+                {
+                    size_t seq = item.seq_;
+                    stage.ordered_.emplace(seq, std::move(item));
+                }
+                else
+                {
+                    stage.unordered_.push_back(std::move(item));
+                }
+                return;
+            }
+            stage.busy_ = true;
+        }
+        item.ownsStage_ = false;
+
+        if (!item.failed_)
+        {
+            try
+            {
+                item.value_ = stage.fn_(std::move(item.value_));
+            }
+            catch (...)
+            {
+                item.failed_ = true;
+                item.value_ = Any();
+                setError(std::current_exception());
+            }
+        }
+        if (!serial)
+        {
+            continue;
+        }
+
+        // 让出串行阶段, 缓冲里轮到的那个直接交给新任务, 阶段保持占用
+        Item next;
+        bool hasNext = false;
+        {
+            std::lock_guard<std::mutex> guard(stage.mutex_);
+            ++stage.nextSeq_;
+            if (stage.mode_ == StageMode::SERIAL_IN_ORDER)
+            {
+                auto it = stage.ordered_.find(stage.nextSeq_);
+                if (it != stage.ordered_.end())
+                {
+                    next = std::move(it->second);
+                    stage.ordered_.erase(it);
+                    hasNext = true;
+                }
+            }
+            else if (!stage.unordered_.empty())
+            {
+                next = std::move(stage.unordered_.front());
+                stage.unordered_.pop_front();
+                hasNext = true;
+            }
+            stage.busy_ = hasNext;
+        }
+        if (hasNext)
+        {
+            next.ownsStage_ = true;
+            spawn(&next);
+        }
+    }
+    --inFlight_;
+}
+
+void Pipeline::spawn(Item* item)
+{
+    {
+        std::lock_guard<std::mutex> guard(doneMutex_);
+        ++liveTasks_;
+    }
+    auto task = std::make_shared<PipelineTask>(this, item);
+    // 工作线程里提交的进本地队列, 不会失败; 只有run()的第一次提交可能失败, 失败就在这里执行
+    if (!submit_(task))
+    {
+        task->run();
+    }
+}
+
+void Pipeline::setError(std::exception_ptr error)
+{
+    sourceDone_ = true;
+    std::lock_guard<std::mutex> guard(doneMutex_);
+    if (!error_)
+    {
+        error_ = error;
+    }
+}
+
+void Pipeline::taskExit()
+{
+    // 归零以后run()就可能返回, 流水线对象可能被销毁, 这之后不能再碰成员
+    std::lock_guard<std::mutex> guard(doneMutex_);
+    if (--liveTasks_ == 0)
+    {
+        doneCond_.notify_all();
+    }
+}
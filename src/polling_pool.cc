@@ -0,0 +1,178 @@
+#include "polling_pool.h"
+#include "tracer.h"
+#include <iostream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// 忙等的时候让出流水线给同核的超线程, 也降低功耗
+static inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// **************************PollingLane实现*****************************
+PollingLane::PollingLane(size_t capacity)
+    : tail_(0)
+    , headCache_(0)
+    , head_(0)
+    , tailCache_(0)
+{
+    size_t size = 1;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+    slots_.resize(size);
+    mask_ = size - 1;
+}
+
+Result PollingLane::submitTask(std::shared_ptr<Task> sp)
+{
+    POOL_TRACE(TraceEvent::SUBMIT, sp.get());
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - headCache_ > mask_)
+    {
+        // 看起来满了, 重新读一次消费位置
+        headCache_ = head_.load(std::memory_order_acquire);
+        if (tail - headCache_ > mask_)
+        {
+            std::cerr << "任务提交失败!!" << std::endl;
+            return Result(sp, false);
+        }
+    }
+
+    // 入队前先绑定完成状态, 入队后任务随时可能被执行
+    Result res(sp, true);
+    POOL_TRACE(TraceEvent::ENQUEUE, sp.get());
+    slots_[tail & mask_] = std::move(sp);
+    tail_.store(tail + 1, std::memory_order_release);
+    return res;
+}
+
+size_t PollingLane::size() const
+{
+    return tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_relaxed);
+}
+
+std::shared_ptr<Task> PollingLane::pop()
+{
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tailCache_)
+    {
+        tailCache_ = tail_.load(std::memory_order_acquire);
+        if (head == tailCache_)
+        {
+            return nullptr;
+        }
+    }
+    std::shared_ptr<Task> task = std::move(slots_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return task;
+}
+
+// **************************PollingPool实现*****************************
+PollingPool::PollingPool(int workers, std::vector<int> cpus)
+    : workerSize_(workers > 0 ? workers : 1)
+    , cpus_(std::move(cpus))
+    , isRunning_(false)
+{}
+
+PollingPool::~PollingPool()
+{
+    stop();
+}
+
+PollingLane& PollingPool::addLane(size_t capacity)
+{
+    if (isRunning_)
+    {
+        throw std::logic_error("PollingPool: addLane() after start()");
+    }
+    lanes_.emplace_back(new PollingLane(capacity));
+    return *lanes_.back();
+}
+
+void PollingPool::start()
+{
+    if (isRunning_)
+    {
+        return;
+    }
+    isRunning_ = true;
+    for (int i = 0; i < workerSize_; ++i)
+    {
+        // 通道按添加顺序轮流分配, 每个通道只有一个消费者
+        std::vector<PollingLane*> lanes;
+        for (size_t l = i; l < lanes_.size(); l += workerSize_)
+        {
+            lanes.push_back(lanes_[l].get());
+        }
+        workers_.emplace_back(&PollingPool::pollFunc, this, i, std::move(lanes));
+    }
+}
+
+void PollingPool::stop()
+{
+    if (!isRunning_.exchange(false))
+    {
+        return;
+    }
+    for (auto& t : workers_)
+    {
+        t.join();
+    }
+    workers_.clear();
+}
+
+void PollingPool::pollFunc(int index, std::vector<PollingLane*> lanes)
+{
+#ifdef __linux__
+    if (!cpus_.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus_[index % cpus_.size()], &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        {
+            std::cerr << "轮询线程绑定cpu " << cpus_[index % cpus_.size()] << " 失败" << std::endl;
+        }
+    }
+#endif
+    POOL_TRACE(TraceEvent::SPAWN, nullptr);
+
+    for (;;)
+    {
+        // 先读停止标志再扫一遍通道, 停止以后最后这一遍扫空了才退出
+        bool running = isRunning_.load(std::memory_order_acquire);
+        bool found = false;
+        for (PollingLane* lane : lanes)
+        {
+            std::shared_ptr<Task> task = lane->pop();
+            if (task != nullptr)
+            {
+                found = true;
+                POOL_TRACE(TraceEvent::DEQUEUE, task.get());
+                POOL_TRACE(TraceEvent::START, task.get());
+                task->exec();
+                POOL_TRACE(TraceEvent::END, task.get());
+            }
+        }
+        if (!found)
+        {
+            if (!running)
+            {
+                break;
+            }
+            cpuRelax();
+        }
+    }
+
+    POOL_TRACE(TraceEvent::EXIT, nullptr);
+}
@@ -0,0 +1,201 @@
+#include "recorder.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    const char RECORD_MAGIC[4] = {'T', 'P', 'W', 'R'};
+    const uint32_t RECORD_VERSION = 1;
+    const size_t RECORD_BATCH = 4096; // 攒够这么多条写一次文件
+
+    // 文件头
+    struct RecordHeader
+    {
+        char magic_[4];
+        uint32_t version_;
+        uint32_t recordSize_;
+    };
+
+    std::atomic<uint32_t> nextThreadIndex(1);
+    std::atomic<uint64_t> nextGeneration(1); // 所有记录器共用, 换了记录器或者重新开始都不会认错缓冲区
+}
+
+// 一个线程在一次记录里的缓冲区, 只有所属线程追加, 写满了自己写文件, stop()时取走剩下的
+struct WorkloadRecorder::ThreadBuffer
+{
+    explicit ThreadBuffer(uint64_t generation)
+        : generation_(generation)
+        , retired_(false)
+    {
+        records_.reserve(RECORD_BATCH);
+    }
+
+    std::mutex mutex_; // 所属线程和stop()之间用, 平时没有竞争
+    std::vector<WorkloadRecord> records_;
+    uint64_t generation_;
+    std::atomic_bool retired_; // 这次记录已经结束, 线程下次注册缓冲区时丢掉它
+};
+
+WorkloadRecorder::WorkloadRecorder()
+    : enabled_(false)
+    , startNs_(0)
+    , generation_(0)
+    , recorded_(0)
+{}
+
+WorkloadRecorder::~WorkloadRecorder()
+{
+    stop();
+}
+
+bool WorkloadRecorder::start(const std::string& path)
+{
+    stop();
+    std::lock_guard<std::mutex> control(controlMutex_);
+    std::lock_guard<std::mutex> guard(mutex_);
+    file_.open(path, std::ios::binary | std::ios::trunc);
+    if (!file_)
+    {
+        std::cerr << "打不开记录文件: " << path << std::endl;
+        return false;
+    }
+    RecordHeader header;
+    memcpy(header.magic_, RECORD_MAGIC, sizeof(RECORD_MAGIC));
+    header.version_ = RECORD_VERSION;
+    header.recordSize_ = sizeof(WorkloadRecord);
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    recorded_ = 0;
+    startNs_ = nowNs();
+    generation_ = nextGeneration++;
+    enabled_ = true;
+    return true;
+}
+
+void WorkloadRecorder::stop()
+{
+    std::lock_guard<std::mutex> control(controlMutex_);
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (!enabled_)
+        {
+            return;
+        }
+        // 之后不再注册新的缓冲区
+        enabled_ = false;
+        buffers = buffers_;
+    }
+
+    // 写完每个线程剩下的记录; 和正在记录的线程一样先拿缓冲区的锁
+    for (auto& buffer : buffers)
+    {
+        std::lock_guard<std::mutex> lock(buffer->mutex_);
+        flush(buffer.get());
+        buffer->retired_ = true;
+    }
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    buffers_.clear();
+    file_.close();
+}
+
+void WorkloadRecorder::record(int64_t submitNs, uint32_t thread, int64_t runNs, uint32_t tag)
+{
+    // 开始记录之前提交的不记
+    if (!enabled_)
+    {
+        return;
+    }
+    uint64_t generation = generation_;
+    int64_t startNs = startNs_;
+    if (submitNs < startNs)
+    {
+        return;
+    }
+    ThreadBuffer* buffer = threadBuffer(generation);
+    if (buffer == nullptr)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(buffer->mutex_);
+    buffer->records_.push_back(WorkloadRecord{(uint64_t)(submitNs - startNs), (uint64_t)runNs, thread, tag});
+    if (buffer->records_.size() >= RECORD_BATCH)
+    {
+        flush(buffer);
+    }
+}
+
+WorkloadRecorder::ThreadBuffer* WorkloadRecorder::threadBuffer(uint64_t generation)
+{
+    // 一个线程可能给几个线程池的记录器记, 每个记录器一个缓冲区
+    thread_local std::vector<std::shared_ptr<ThreadBuffer>> localBuffers;
+    for (auto& buffer : localBuffers)
+    {
+        if (buffer->generation_ == generation)
+        {
+            return buffer.get();
+        }
+    }
+
+    // 第一次给这次记录记, 顺便丢掉已经结束的记录的缓冲区
+    localBuffers.erase(std::remove_if(localBuffers.begin(), localBuffers.end(),
+        [](const std::shared_ptr<ThreadBuffer>& buffer) -> bool
+        {
+            return buffer->retired_;
+        }), localBuffers.end());
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (!enabled_ || generation_ != generation)
+    {
+        return nullptr;
+    }
+    auto buffer = std::make_shared<ThreadBuffer>(generation);
+    buffers_.push_back(buffer);
+    localBuffers.push_back(buffer);
+    return buffer.get();
+}
+
+void WorkloadRecorder::flush(ThreadBuffer* buffer)
+{
+    if (buffer->records_.empty())
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(mutex_);
+    // 记录已经结束, 这个缓冲区的记录stop()写过了或者来不及写, 不记
+    if (!buffer->retired_ && file_.is_open())
+    {
+        file_.write(reinterpret_cast<const char*>(buffer->records_.data()),
+            buffer->records_.size() * sizeof(WorkloadRecord));
+        recorded_ += buffer->records_.size();
+    }
+    buffer->records_.clear();
+}
+
+uint32_t WorkloadRecorder::threadIndex()
+{
+    thread_local uint32_t index = nextThreadIndex++;
+    return index;
+}
+
+bool WorkloadRecorder::load(const std::string& path, std::vector<WorkloadRecord>& records)
+{
+    std::ifstream in(path, std::ios::binary);
+    RecordHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || memcmp(header.magic_, RECORD_MAGIC, sizeof(RECORD_MAGIC)) != 0
+        || header.version_ != RECORD_VERSION
+        || header.recordSize_ != sizeof(WorkloadRecord))
+    {
+        return false;
+    }
+    WorkloadRecord record;
+    while (in.read(reinterpret_cast<char*>(&record), sizeof(record)))
+    {
+        records.push_back(record);
+    }
+    return true;
+}
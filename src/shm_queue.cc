@@ -0,0 +1,489 @@
+#include "shm_queue.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace
+{
+    const char SHM_MAGIC[4] = {'T', 'P', 'S', 'Q'};
+    const uint32_t SHM_VERSION = 2;
+    const uint8_t BLOCK_FREE = 1;  // 数据块在空闲环里
+    const uint8_t BLOCK_TAKEN = 0; // 数据块被提交方拿走, 还没还回来
+    const std::chrono::milliseconds PUMP_BACKOFF_MAX(64); // 线程池满时搬运线程重试的最长间隔
+
+    // 映射里各部分都按缓存行对齐
+    size_t alignUp(size_t n)
+    {
+        return (n + 63) & ~size_t(63);
+    }
+
+    uint32_t roundUpPow2(uint32_t n)
+    {
+        uint32_t cap = 1;
+        while (cap < n)
+        {
+            cap <<= 1;
+        }
+        return cap;
+    }
+
+    // 不带FUTEX_PRIVATE_FLAG, 别的进程映射的同一个字也能唤醒
+    void futexWait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::milliseconds timeout)
+    {
+        struct timespec ts;
+        ts.tv_sec = timeout.count() / 1000;
+        ts.tv_nsec = (timeout.count() % 1000) * 1000000;
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+    }
+
+    void futexWake(std::atomic<uint32_t>& word, int count)
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, count, nullptr, nullptr, 0);
+    }
+
+    // 推进去以后叫醒等着的一方
+    template <typename T>
+    void signalRing(ShmRing<T>& ring, int count)
+    {
+        ring.signal().fetch_add(1);
+        if (ring.waiters().load() > 0)
+        {
+            futexWake(ring.signal(), count);
+        }
+    }
+
+    // 空了就在signal字上睡一会, 先登记等待者再看一次, 不会漏掉唤醒
+    template <typename T>
+    bool waitRing(ShmRing<T>& ring, T& value, std::chrono::milliseconds timeout)
+    {
+        if (ring.tryPop(value))
+        {
+            return true;
+        }
+        uint32_t signal = ring.signal().load();
+        ring.waiters().fetch_add(1);
+        if (!ring.tryPop(value))
+        {
+            futexWait(ring.signal(), signal, timeout);
+        }
+        else
+        {
+            ring.waiters().fetch_sub(1);
+            return true;
+        }
+        ring.waiters().fetch_sub(1);
+        return ring.tryPop(value);
+    }
+}
+
+// 映射开头的布局信息, 打开方按这个找到各部分
+struct ShmQueue::Layout
+{
+    char magic_[4];
+    uint32_t version_;
+    uint32_t blocks_;           // 2的幂, 各个环的容量都是它
+    uint32_t blockSize_;
+    uint32_t clients_;
+    uint32_t reserved_;
+    uint64_t size_;             // 整个映射的字节数
+    uint64_t submitOffset_;
+    uint64_t freeOffset_;
+    uint64_t completionOffset_;
+    uint64_t completionStride_; // 每个完成环占的字节数
+    uint64_t blockStateOffset_; // 每个数据块一个状态字节, 挡住重复归还
+    uint64_t dataOffset_;
+};
+static_assert(std::atomic<uint8_t>::is_always_lock_free, "block states need lock-free byte atomics");
+
+std::unique_ptr<ShmQueue> ShmQueue::create(const std::string& name, const ShmQueueOptions& options)
+{
+    uint32_t blocks = roundUpPow2(std::max<uint32_t>(options.blocks_, 2));
+    uint32_t blockSize = (uint32_t)alignUp(std::max<uint32_t>(options.blockSize_, 1));
+    uint32_t clients = std::max<uint32_t>(options.clients_, 1);
+
+    Layout layout;
+    memcpy(layout.magic_, SHM_MAGIC, sizeof(SHM_MAGIC));
+    layout.version_ = SHM_VERSION;
+    layout.blocks_ = blocks;
+    layout.blockSize_ = blockSize;
+    layout.clients_ = clients;
+    layout.reserved_ = 0;
+    layout.submitOffset_ = alignUp(sizeof(Layout));
+    layout.freeOffset_ = layout.submitOffset_ + alignUp(ShmRing<ShmTaskDesc>::bytes(blocks));
+    layout.completionOffset_ = layout.freeOffset_ + alignUp(ShmRing<uint64_t>::bytes(blocks));
+    layout.completionStride_ = alignUp(ShmRing<ShmCompletion>::bytes(blocks));
+    layout.blockStateOffset_ = layout.completionOffset_ + layout.completionStride_ * clients;
+    layout.dataOffset_ = layout.blockStateOffset_ + alignUp(blocks);
+    layout.size_ = layout.dataOffset_ + (uint64_t)blockSize * blocks;
+
+    int fd = name.empty()
+        ? memfd_create("threadpool_shm", MFD_CLOEXEC)
+        : shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+    {
+        std::cerr << "ShmQueue: 创建共享内存失败: " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    if (ftruncate(fd, layout.size_) != 0)
+    {
+        std::cerr << "ShmQueue: 设置共享内存大小失败: " << strerror(errno) << std::endl;
+        close(fd);
+        if (!name.empty())
+        {
+            shm_unlink(name.c_str());
+        }
+        return nullptr;
+    }
+    void* base = mmap(nullptr, layout.size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        std::cerr << "ShmQueue: 映射共享内存失败: " << strerror(errno) << std::endl;
+        close(fd);
+        if (!name.empty())
+        {
+            shm_unlink(name.c_str());
+        }
+        return nullptr;
+    }
+
+    // 先建好各个环, 最后写魔数, 打开方看到魔数时其余部分已经初始化完了
+    char* p = static_cast<char*>(base);
+    ShmRing<ShmTaskDesc>::init(p + layout.submitOffset_, blocks);
+    ShmRing<uint64_t>::init(p + layout.freeOffset_, blocks);
+    for (uint32_t i = 0; i < clients; ++i)
+    {
+        ShmRing<ShmCompletion>::init(p + layout.completionOffset_ + layout.completionStride_ * i, blocks);
+    }
+    for (uint32_t i = 0; i < blocks; ++i)
+    {
+        new (p + layout.blockStateOffset_ + i) std::atomic<uint8_t>(BLOCK_FREE);
+    }
+    Layout* header = reinterpret_cast<Layout*>(p);
+    *header = layout;
+    memset(header->magic_, 0, sizeof(header->magic_));
+
+    std::unique_ptr<ShmQueue> que(new ShmQueue(fd, p, layout.size_, name, !name.empty()));
+    for (uint32_t i = 0; i < blocks; ++i)
+    {
+        que->freeRing_.tryPush(layout.dataOffset_ + (uint64_t)blockSize * i);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic_, SHM_MAGIC, sizeof(SHM_MAGIC));
+    return que;
+}
+
+std::unique_ptr<ShmQueue> ShmQueue::open(const std::string& name)
+{
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+    {
+        std::cerr << "ShmQueue: 打开共享内存失败: " << name << ": " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    std::unique_ptr<ShmQueue> que = openFd(fd);
+    if (que == nullptr)
+    {
+        close(fd);
+        return nullptr;
+    }
+    que->name_ = name;
+    return que;
+}
+
+std::unique_ptr<ShmQueue> ShmQueue::openFd(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Layout))
+    {
+        std::cerr << "ShmQueue: 共享内存大小不对" << std::endl;
+        return nullptr;
+    }
+    void* base = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        std::cerr << "ShmQueue: 映射共享内存失败: " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    const Layout* header = static_cast<const Layout*>(base);
+    if (memcmp(header->magic_, SHM_MAGIC, sizeof(SHM_MAGIC)) != 0 || header->version_ != SHM_VERSION
+        || header->size_ != (uint64_t)st.st_size)
+    {
+        std::cerr << "ShmQueue: 不是线程池的共享内存队列, 或者还没初始化完" << std::endl;
+        munmap(base, st.st_size);
+        return nullptr;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return std::unique_ptr<ShmQueue>(new ShmQueue(fd, static_cast<char*>(base), st.st_size, "", false));
+}
+
+ShmQueue::ShmQueue(int fd, char* base, size_t size, std::string name, bool owner)
+    : fd_(fd)
+    , base_(base)
+    , size_(size)
+    , name_(std::move(name))
+    , owner_(owner)
+{
+    attach();
+}
+
+ShmQueue::~ShmQueue()
+{
+    munmap(base_, size_);
+    close(fd_);
+    if (owner_)
+    {
+        shm_unlink(name_.c_str());
+    }
+}
+
+void ShmQueue::attach()
+{
+    const Layout* header = reinterpret_cast<const Layout*>(base_);
+    submitRing_ = ShmRing<ShmTaskDesc>(base_ + header->submitOffset_, header->blocks_);
+    freeRing_ = ShmRing<uint64_t>(base_ + header->freeOffset_, header->blocks_);
+    completionRings_.reset(new ShmRing<ShmCompletion>[header->clients_]);
+    for (uint32_t i = 0; i < header->clients_; ++i)
+    {
+        completionRings_[i] = ShmRing<ShmCompletion>(
+            base_ + header->completionOffset_ + header->completionStride_ * i, header->blocks_);
+    }
+}
+
+uint32_t ShmQueue::blockSize() const
+{
+    return reinterpret_cast<const Layout*>(base_)->blockSize_;
+}
+
+uint32_t ShmQueue::clients() const
+{
+    return reinterpret_cast<const Layout*>(base_)->clients_;
+}
+
+bool ShmQueue::isBlock(uint64_t offset) const
+{
+    const Layout* header = reinterpret_cast<const Layout*>(base_);
+    return offset >= header->dataOffset_ && offset < header->size_
+        && (offset - header->dataOffset_) % header->blockSize_ == 0;
+}
+
+std::atomic<uint8_t>& ShmQueue::blockState(uint64_t offset) const
+{
+    const Layout* header = reinterpret_cast<const Layout*>(base_);
+    uint64_t index = (offset - header->dataOffset_) / header->blockSize_;
+    return *reinterpret_cast<std::atomic<uint8_t>*>(base_ + header->blockStateOffset_ + index);
+}
+
+bool ShmQueue::isValid(const ShmTaskDesc& desc) const
+{
+    const Layout* header = reinterpret_cast<const Layout*>(base_);
+    return desc.client_ < header->clients_ && desc.size_ <= header->blockSize_
+        && isBlock(desc.offset_) && blockState(desc.offset_).load() == BLOCK_TAKEN;
+}
+
+bool ShmQueue::submit(uint32_t client, uint64_t id, uint32_t type, const void* data, uint32_t size)
+{
+    if (client >= clients() || size > blockSize())
+    {
+        return false;
+    }
+    uint64_t offset;
+    if (!freeRing_.tryPop(offset))
+    {
+        return false;
+    }
+    blockState(offset).store(BLOCK_TAKEN);
+    memcpy(base_ + offset, data, size);
+
+    ShmTaskDesc desc;
+    desc.id_ = id;
+    desc.offset_ = offset;
+    desc.size_ = size;
+    desc.type_ = type;
+    desc.client_ = client;
+    desc.reserved_ = 0;
+    // 提交环和空闲环容量一样, 拿到了数据块就一定推得进去
+    submitRing_.tryPush(desc);
+    signalRing(submitRing_, 1);
+    return true;
+}
+
+bool ShmQueue::tryComplete(uint32_t client, ShmCompletion& completion)
+{
+    return client < clients() && completionRings_[client].tryPop(completion);
+}
+
+bool ShmQueue::waitComplete(uint32_t client, ShmCompletion& completion, std::chrono::milliseconds timeout)
+{
+    return client < clients() && waitRing(completionRings_[client], completion, timeout);
+}
+
+bool ShmQueue::release(uint64_t offset)
+{
+    // 偏移是提交方进程给的, 和描述符一样先检查; 同一个数据块还两次会被两个请求同时用, 只认第一次
+    if (!isBlock(offset) || blockState(offset).exchange(BLOCK_FREE) == BLOCK_FREE)
+    {
+        return false;
+    }
+    // 只有拿走的数据块才能还进来, 空闲环不会满
+    freeRing_.tryPush(offset);
+    return true;
+}
+
+bool ShmQueue::tryTake(ShmTaskDesc& desc)
+{
+    return submitRing_.tryPop(desc);
+}
+
+bool ShmQueue::waitTake(ShmTaskDesc& desc, std::chrono::milliseconds timeout)
+{
+    return waitRing(submitRing_, desc, timeout);
+}
+
+void ShmQueue::wakeTakers()
+{
+    signalRing(submitRing_, INT_MAX);
+}
+
+void ShmQueue::complete(const ShmTaskDesc& desc, int32_t status, uint32_t size)
+{
+    ShmCompletion completion;
+    completion.id_ = desc.id_;
+    completion.offset_ = desc.offset_;
+    completion.size_ = size;
+    completion.status_ = status;
+    // 每个在途请求占一个数据块, 完成环和数据块一样多, 推不进去只是提交方还没取完
+    ShmRing<ShmCompletion>& ring = completionRings_[desc.client_];
+    while (!ring.tryPush(completion))
+    {
+        std::this_thread::yield();
+    }
+    signalRing(ring, 1);
+}
+
+// **************************ShmTaskServer实现*****************************
+
+// 一个从共享内存来的请求, 包成任务交给线程池
+class ShmTask : public Task
+{
+public:
+    ShmTask(ShmTaskServer* server, const ShmTaskDesc& desc)
+        : server_(server), desc_(desc) {}
+
+    Any run() override
+    {
+        server_->serve(desc_);
+        return 0;
+    }
+
+private:
+    ShmTaskServer* server_;
+    ShmTaskDesc desc_;
+};
+
+ShmTaskServer::ShmTaskServer(ShmQueue& queue, Handler handler)
+    : queue_(queue)
+    , handler_(std::move(handler))
+    , stop_(false)
+    , served_(0)
+    , inFlight_(0)
+{}
+
+ShmTaskServer::~ShmTaskServer()
+{
+    stop();
+}
+
+void ShmTaskServer::startImpl()
+{
+    stop_ = false;
+    pumpThread_ = std::thread(&ShmTaskServer::pumpLoop, this);
+}
+
+void ShmTaskServer::stop()
+{
+    if (!pumpThread_.joinable())
+    {
+        return;
+    }
+    stop_ = true;
+    queue_.wakeTakers();
+    pumpThread_.join();
+
+    std::unique_lock<std::mutex> lock(inFlightMutex_);
+    inFlightCond_.wait(lock, [&]() -> bool { return inFlight_ == 0; });
+}
+
+void ShmTaskServer::pumpLoop()
+{
+    while (!stop_)
+    {
+        ShmTaskDesc desc;
+        if (!queue_.waitTake(desc, std::chrono::milliseconds(100)))
+        {
+            continue;
+        }
+        // 描述符是别的进程写的, 越界的直接丢掉
+        if (!queue_.isValid(desc))
+        {
+            std::cerr << "ShmTaskServer: 丢弃无效的任务描述符" << std::endl;
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(inFlightMutex_);
+            ++inFlight_;
+        }
+        // 线程池满了不在提交里阻塞, 退避着重试, 这期间不取新的描述符
+        // 停止时还没交出去的在这里直接执行, 提交方总能收到完成记录
+        std::chrono::milliseconds backoff(1);
+        while (!submit_(std::make_shared<ShmTask>(this, desc)))
+        {
+            if (stop_)
+            {
+                serve(desc);
+                break;
+            }
+            std::this_thread::sleep_for(backoff);
+            backoff = std::min(backoff * 2, PUMP_BACKOFF_MAX);
+        }
+    }
+}
+
+void ShmTaskServer::serve(const ShmTaskDesc& desc)
+{
+    ShmRequest req;
+    req.type_ = desc.type_;
+    req.data_ = queue_.data(desc.offset_);
+    req.size_ = desc.size_;
+    req.capacity_ = queue_.blockSize();
+    req.resultSize_ = 0;
+
+    int32_t status;
+    try
+    {
+        status = handler_(req);
+    }
+    catch (...)
+    {
+        status = -1;
+        req.resultSize_ = 0;
+    }
+    queue_.complete(desc, status, std::min(req.resultSize_, req.capacity_));
+    ++served_;
+
+    std::lock_guard<std::mutex> guard(inFlightMutex_);
+    if (--inFlight_ == 0)
+    {
+        inFlightCond_.notify_all();
+    }
+}
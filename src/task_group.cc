@@ -0,0 +1,320 @@
+#include "task_group.h"
+#include <algorithm>
+#include <vector>
+
+// 组里的任务: 取消了就跳过, 异常交给组
+class GroupTask : public Task
+{
+public:
+    GroupTask(TaskGroup* group, std::shared_ptr<Task> task)
+        : settled_(false), group_(group), task_(std::move(task)) {}
+
+    Any run() override
+    {
+        group_->taskDone(this, execute());
+        return 0;
+    }
+
+    // 执行用户的任务, 返回它抛出的异常
+    std::exception_ptr execute()
+    {
+        std::exception_ptr error;
+        if (!group_->isCancelled())
+        {
+            try
+            {
+                task_->run();
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+        }
+        task_.reset(); // 组可能在记账以后被wait()放行, 先释放用户的任务
+        return error;
+    }
+
+    bool settled_; // 已经记过结束了, 组的mutex_保护
+
+private:
+    TaskGroup* group_;
+    std::shared_ptr<Task> task_;
+};
+
+TaskGroup::TaskGroup(int maxConcurrency)
+    : maxConcurrency_(std::max(maxConcurrency, 0))
+    , active_(0)
+    , pending_(0)
+    , busy_(0)
+    , cancelled_(false)
+{}
+
+TaskGroup::~TaskGroup()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    doneCond_.wait(lock, [&]() -> bool { return idle(); });
+}
+
+void TaskGroup::run(std::shared_ptr<Task> task)
+{
+    auto wrapped = std::make_shared<GroupTask>(this, std::move(task));
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (cancelled_)
+        {
+            return;
+        }
+        ++pending_;
+        if (maxConcurrency_ > 0 && active_ >= (size_t)maxConcurrency_)
+        {
+            parked_.emplace_back(std::move(wrapped));
+            return;
+        }
+        ++active_;
+        ++busy_;
+    }
+    submit(std::move(wrapped));
+}
+
+void TaskGroup::submit(std::shared_ptr<GroupTask> task)
+{
+    while (true)
+    {
+        CancellationToken token = CancellationToken::none();
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            token = token_;
+        }
+
+        // 工作线程里提交的进本地队列, 不会失败; 外部线程提交时队列满了或者线程池停了就不收, 不等空位
+        Result res = submit_(task, token);
+        if (res.isValid())
+        {
+            std::vector<Result> dropped; // 撤回的任务在组的锁外面析构
+            std::lock_guard<std::mutex> guard(mutex_);
+            // 已经在别的线程上执行完的不用登记
+            if (!task->settled_)
+            {
+                inFlight_.emplace(task.get(), std::move(res));
+                // 提交前token已经取消的话, 线程池直接撤回了这个任务, cancel()那边没看到它
+                collectCancelled(dropped);
+            }
+            leaveLocked();
+            return;
+        }
+
+        // 线程池不收, 在当前线程执行; 接替名额的停着的任务回到循环开头接着提交
+        Followup followup;
+        bool more = finish(task.get(), task->execute(), followup);
+        leave();
+        if (!more)
+        {
+            return;
+        }
+        if (followup.next_ == nullptr)
+        {
+            cancelSubmitted(followup.token_);
+            leave();
+            return;
+        }
+        // finish占的busy_留给下一个任务
+        task = std::move(followup.next_);
+    }
+}
+
+bool TaskGroup::settle(GroupTask* task)
+{
+    if (task->settled_)
+    {
+        return false;
+    }
+    task->settled_ = true;
+    inFlight_.erase(task);
+    return true;
+}
+
+void TaskGroup::collectCancelled(std::vector<Result>& dropped)
+{
+    for (auto it = inFlight_.begin(); it != inFlight_.end();)
+    {
+        GroupTask* task = it->first;
+        if (!it->second.isCancelled())
+        {
+            ++it;
+            continue;
+        }
+        dropped.emplace_back(std::move(it->second));
+        ++it;
+        settle(task);
+        // 组已经取消, 没有停着的任务要接替名额
+        --pending_;
+        --active_;
+    }
+    if (idle())
+    {
+        doneCond_.notify_all();
+    }
+}
+
+void TaskGroup::cancelSubmitted(CancellationToken token)
+{
+    // 还在线程池队列里的任务撤回, 马上让出名额; 要拿线程池的锁, 放在组的锁外面
+    token.cancel();
+
+    std::vector<Result> dropped;
+    std::lock_guard<std::mutex> guard(mutex_);
+    collectCancelled(dropped);
+}
+
+void TaskGroup::taskDone(GroupTask* task, std::exception_ptr error)
+{
+    // 没有后续的话记完账组就可能被销毁, 直接返回
+    Followup followup;
+    if (!finish(task, error, followup))
+    {
+        return;
+    }
+    if (followup.next_ != nullptr)
+    {
+        submit(std::move(followup.next_));
+        return;
+    }
+    cancelSubmitted(followup.token_);
+    leave();
+}
+
+bool TaskGroup::finish(GroupTask* task, std::exception_ptr error, Followup& followup)
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (!settle(task))
+    {
+        return false;
+    }
+    if (error)
+    {
+        if (!error_)
+        {
+            error_ = error;
+        }
+        cancelled_ = true;
+        pending_ -= parked_.size();
+        parked_.clear();
+        followup.cancel_ = true;
+        followup.token_ = token_;
+    }
+    --pending_;
+    if (!parked_.empty() && (maxConcurrency_ == 0 || active_ <= (size_t)maxConcurrency_))
+    {
+        // 名额直接交给停着的任务, active_不变
+        followup.next_ = std::move(parked_.front());
+        parked_.pop_front();
+    }
+    else
+    {
+        --active_;
+    }
+
+    bool more = followup.next_ != nullptr || followup.cancel_;
+    if (more)
+    {
+        ++busy_;
+    }
+    else if (idle())
+    {
+        doneCond_.notify_all();
+    }
+    return more;
+}
+
+void TaskGroup::leave()
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    leaveLocked();
+}
+
+void TaskGroup::leaveLocked()
+{
+    if (--busy_ == 0 && pending_ == 0)
+    {
+        doneCond_.notify_all();
+    }
+}
+
+bool TaskGroup::wait()
+{
+    bool done = false;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        done = idle();
+    }
+    if (!done)
+    {
+        // 进出阻塞区要拿线程池的锁, 不在组的锁里做
+        ThreadPoolBase::blocking_scope blocking;
+        std::unique_lock<std::mutex> lock(mutex_);
+        doneCond_.wait(lock, [&]() -> bool { return idle(); });
+    }
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    bool completed = !cancelled_;
+    if (cancelled_)
+    {
+        // 旧的token已经取消了, 换一个给之后的任务用
+        cancelled_ = false;
+        token_ = CancellationToken();
+    }
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    return completed;
+}
+
+void TaskGroup::cancel()
+{
+    CancellationToken token = CancellationToken::none();
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        cancelled_ = true;
+        pending_ -= parked_.size();
+        parked_.clear();
+        token = token_;
+        ++busy_; // 撤回时组的任务可能全部结束, 别的线程的wait()不能在这之前放行
+    }
+    cancelSubmitted(token);
+    leave();
+}
+
+bool TaskGroup::isCancelled() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return cancelled_;
+}
+
+void TaskGroup::setMaxConcurrency(int maxConcurrency)
+{
+    std::vector<std::shared_ptr<GroupTask>> released;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        maxConcurrency_ = std::max(maxConcurrency, 0);
+        while (!parked_.empty() && (maxConcurrency_ == 0 || active_ < (size_t)maxConcurrency_))
+        {
+            released.emplace_back(std::move(parked_.front()));
+            parked_.pop_front();
+            ++active_;
+            ++busy_;
+        }
+    }
+    for (std::shared_ptr<GroupTask>& task : released)
+    {
+        submit(std::move(task));
+    }
+}
+
+size_t TaskGroup::pending() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return pending_;
+}
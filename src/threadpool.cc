@@ -1,340 +1,108 @@
 #include "threadpool.h"
+#include "executor_group.h"
+#include "io_reactor.h"
+#include "tracer.h"
 #include <functional>
 #include <iostream>
 #include <thread>
+#include <algorithm>
 
-const int TASK_MAX_THRESHOLD = 2;//INT32_MAX;    // 任务队列最大阈值
-const int Thread_MAX_THRESHOLD = 10; // 线程池最大线程数阈值
-const int THREAD_TIMEOUT = 10; // 线程空闲时间超过60s, 则回收多余的线程
+std::atomic_bool ThreadPoolBase::logEnabled_(true);
 
-ThreadPool::ThreadPool()
-    : taskQueMaxThreshHold_(TASK_MAX_THRESHOLD),
-    ThreadSizeThreshold_(Thread_MAX_THRESHOLD), idleThreadSize_(0),
-    currentThreadSize_(0), taskSize_(0), poolmode_(PoolMode::MODE_FIXED),
-    isPoolRunning_(false)
-{
-    // 初始化线程池
-}
-
-// 线程池析构函数
-ThreadPool::~ThreadPool()
-{
-    /*-- 复现死锁本人解决办法
-    std::cout << "线程池析构函数 调用..." << std::endl;
-    std::unique_lock<std::mutex> lock(taskQueMutex_);
-    startCond_.wait(lock, [&]() -> bool
-        {
-            return taskQue_.size() == 0;
-        });
-    lock.unlock();
-    */
-
-    // 睡一秒
-    // std::this_thread::sleep_for(std::chrono::seconds(1)); // 睡一秒, 等待线程池全部启动
+thread_local ThreadPoolBase* ThreadPoolBase::currentPool_ = nullptr;
+thread_local ThreadPoolBase::LocalQueue* ThreadPoolBase::currentLocalQue_ = nullptr;
+thread_local int ThreadPoolBase::currentThreadId_ = -1;
+thread_local int ThreadPoolBase::helpDepth_ = 0;
+thread_local bool ThreadPoolBase::holdingGroupSlot_ = false;
+thread_local int ThreadPoolBase::blocking_scope::blockingDepth_ = 0;
 
-    std::cout << "线程池析构函数被调用, 正在关闭线程池..." << std::endl;
+// 默认配置的线程池在这里实例化, 编进libthreadpool.so
+template class BasicThreadPool<>;
 
-    isPoolRunning_ = false; // 设置线程池不在运行状态
-    // 等待所有线程结束--线程通信
-    // 阻塞 & 任务执行中
-    std::unique_lock<std::mutex> lock(taskQueMutex_);
+// 非默认的策略也实例化一遍, 改线程池实现时这些组合编不过马上能发现
+template class BasicThreadPool<NoHooks, LifoTaskQueue, SpinThenBlockWait<>,
+                               std::allocator<std::shared_ptr<Task>>, FixedGrowth>;
+template class BasicThreadPool<NoHooks, FifoTaskQueue, BlockingWait,
+                               std::allocator<std::shared_ptr<Task>>, CachedGrowth<>>;
 
-    /*-- 复现死锁本人解决办法
-    lock.lock(); // 获取锁
-    */
-
-
-    // 所有线程完成任务了, 此时都在等待 状态, 先唤醒
-    notEmpty_.notify_all(); // 通知所有线程有任务了
-    std::cout << "唤醒所有线程, 准备析构线程池..." << std::endl;
-    exitCond_.wait(lock, [&]() -> bool
-        {
-            return threads_.size() == 0;
-        }); // 等待所有线程回收
-    std::cout << "线程池已关闭, 所有线程已回收!" << std::endl;
+// **************************ThreadPoolBase实现*****************************
+ThreadPoolBase::ThreadPoolBase()
+    : group_(nullptr), groupSlot_(nullptr)
+{}
 
-}
+ThreadPoolBase::~ThreadPoolBase() = default;
 
-// 检查线程池状态
-bool ThreadPool::checkPoolState() const
+unsigned ThreadPoolBase::producerIndex()
 {
-    // 检查线程池是否正在运行
-    return isPoolRunning_;
+    static std::atomic_uint nextIndex(0);
+    thread_local unsigned index = nextIndex++;
+    return index;
 }
 
-// 设置线程池模式--手动设置
-void ThreadPool::setMode(PoolMode mode)
+bool ThreadPoolBase::runPendingTask()
 {
-    if (checkPoolState() != true) // 线程池未运行
+    if (currentPool_ == nullptr || helpDepth_ >= HELP_DEPTH_MAX)
     {
-        poolmode_ = mode; // 设置线程池模式
-    }
-    else
-    {
-        std::cerr << "线程池已经在运行, 无法修改模式!" << std::endl;
-        return;
+        return false;
     }
+    ++helpDepth_;
+    bool ran = currentPool_->helpOnce();
+    --helpDepth_;
+    return ran;
 }
 
-// 设置task队列最大线程数
-void ThreadPool::setTaskQueMaxThreshHold(int size)
+IoReactor& ThreadPoolBase::reactor()
 {
-    if (checkPoolState() == true)
-    {
-        std::cerr << "线程池已经在运行, 无法修改任务队列最大线程数!" << std::endl;
-        return;
-    }
-    taskQueMaxThreshHold_ = size; // 设置任务队列最大线程数
+    std::call_once(reactorOnce_, [this]()
+        {
+            reactor_ = std::make_unique<IoReactor>(*this);
+        });
+    return *reactor_;
 }
 
-// 设置线程池cached模式线程数量阈值, 用于动态变化线程池模式
-void ThreadPool::setThreadSizeThreshHold(int size)
+void ThreadPoolBase::stopReactor()
 {
-    if (checkPoolState() == true)
-    {
-        std::cerr << "线程池已经在运行, 无法修改线程池线程数量阈值!" << std::endl;
-        return;
-    }
-    if (poolmode_ == PoolMode::MODE_CACHED)
-    {
-        ThreadSizeThreshold_ = size; // 设置线程池线程数量阈值
-    }
-    else
+    // 派生类析构时调用, 不会和reactor()并发
+    if (reactor_ != nullptr)
     {
-        std::cerr << "线程池模式不是动态变化线程池, 无法修改线程池线程数量阈值!"
-            << std::endl;
-        return;
+        reactor_->stop();
     }
 }
 
-// 提交任务到线程池
-Result ThreadPool::submitTask(std::shared_ptr<Task> sp)
+void ThreadPoolBase::acquireGroupSlot()
 {
-    // 获取锁
-    std::unique_lock<std::mutex> lock(taskQueMutex_);
-    // 线程通信 等待任务队列有空余
-    // while(taskQue_.size() == TASK_MAX_THRESHOLD)
-    // {
-    //     notFull_.wait(lock); // 等待任务队列不满   条件变量,不要搞混信号量
-    // }
-    // // 优化   lambda条件成立, 会往下走
-    // notFull_.wait(lock,  [&] (){
-    //     return taskQue_.size() < TASK_MAX_THRESHOLD;
-    // });  // 不理解的话可以看一下wait的源码
-    // // 再次优化 用户任务阻塞不能超过1s
-
-    if (!notFull_.wait_for(lock, std::chrono::seconds(1), [&]()->bool
-        {
-            return taskQue_.size() < (size_t)taskQueMaxThreshHold_;
-        }))
-    {
-        // 超时了, 任务队列满了
-        std::cerr << "任务提交失败!!" << std::endl;
-
-        // return; // 任务提交失败
-        // return task->getResult(); // 设计细节
-        return Result(sp, false);
-        // Result res(sp, false);
-        // return std::move(res); // 返回结果, 任务提交失败
-    }
-
-    // 有空余 将任务添加到任务队列
-    taskQue_.emplace(sp);
-    ++taskSize_;
-
-    // 通知有任务
-    notEmpty_.notify_all(); // 通知有任务了
-
-    if (poolmode_ == PoolMode::MODE_CACHED && taskSize_ > idleThreadSize_ &&
-        currentThreadSize_ < ThreadSizeThreshold_)
-    {
-        std::cout << "创建新线程..." << std::endl;
-        // 这里不能使用 线程id,  这是主线程, 打印的都是一样的
-
-        auto ptr =
-            std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc, this, std::placeholders::_1));
-        int threadId = ptr->getThreadId(); // 获取线程ID
-        threads_.emplace(threadId, std::move(ptr)); // 使用unordered_map存储线程对象
-
-        threads_[threadId]->start(); // 启动线程
-
-
-        // 修改线程数量相关
-        currentThreadSize_++; // 线程池当前线程总数量加1
-        idleThreadSize_++; // 空闲线程数量加1
-    }
-
-
-    return Result(sp, true); // 返回结果, 任务提交成功
+    group_->acquire(groupSlot_);
+    holdingGroupSlot_ = true;
 }
 
-// 开启线程池
-void ThreadPool::start(int initThreadSize)
+void ThreadPoolBase::releaseGroupSlot()
 {
-    this->isPoolRunning_ = true; // 线程池开始运行
-    // {
-    //     std::unique_lock<std::mutex> lock(taskQueMutex_);
-    this->initThreadSize_ = initThreadSize;
-    this->currentThreadSize_ = initThreadSize;
-
-    std::cout << initThreadSize_ << "个线程被创建, 线程池开始运行..." << std::endl;
-
-    // 创建线程对象
-    for (int i = 0; i < initThreadSize_; ++i)
-    {
-        // 创建线程对象并绑定线程函数
-
-        // threads_.emplace_back(new Thread(std::bind(&ThreadPool::threadFunc,
-        // this))); c++14
-        auto ptr =
-            std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc, this, std::placeholders::_1));
-
-        int threadId = ptr->getThreadId(); // 获取线程ID
+    group_->release(groupSlot_);
+    holdingGroupSlot_ = false;
+}
 
-        // threads_.emplace_back(std::move(ptr));
-        // threads_.emplace_back(ptr);  // 这是c++语言层面的问题
-        threads_.emplace(threadId, std::move(ptr)); // 使用unordered_map存储线程对象
-    }
+bool ThreadPoolBase::groupHasWaiters() const
+{
+    return group_->hasWaiters();
+}
 
-    // 启动线程
-    for (int i = 0; i < initThreadSize_; ++i)
+ThreadPoolBase::blocking_scope::blocking_scope()
+    : pool_(nullptr)
+{
+    // 只有工作线程的最外层阻塞区才算数
+    if (ThreadPoolBase::currentPool_ != nullptr && blockingDepth_++ == 0)
     {
-        // 启动线程的代码
-        threads_[i]->start();
-
-        idleThreadSize_++; // 空闲线程数量加1
+        pool_ = ThreadPoolBase::currentPool_;
+        pool_->enterBlocking();
     }
-    // }
-
-    // startCond_.notify_all(); // 通知线程池全部启动条件变量
-
 }
 
-
-// 线程池退出, 有任务也得先执行完
-// 定义线程函数
-void ThreadPool::threadFunc(int threadid)
+ThreadPoolBase::blocking_scope::~blocking_scope()
 {
-
-    auto lastTime = std::chrono::high_resolution_clock::now(); // 记录线程开始时间
-
-    // for (;;)
-    for (;;)
+    if (ThreadPoolBase::currentPool_ != nullptr && --blockingDepth_ == 0 && pool_ != nullptr)
     {
-        std::shared_ptr<Task> task;
-        {
-            // 获取锁
-            std::unique_lock<std::mutex> lock(taskQueMutex_);
-
-            std::cout << "Thread " << std::this_thread::get_id() << "尝试获取任务..."
-                << std::endl;
-
-            // 区分超时返回和 任务执行返回
-            // 1s返回一次
-            while (taskQue_.size() == 0)
-            {
-                if (!this->isPoolRunning_)
-                {
-                    threads_.erase(threadid);
-                    std::cout << "Thread " << std::this_thread::get_id()
-                        << "线程池不在运行状态, 回收线程..." << std::endl;
-                    exitCond_.notify_all(); // 通知线程池退出条件变量
-                    return;
-                }
-                // cached模式下, 空闲时间超过60s, 则回收多余的线程
-                if (poolmode_ == PoolMode::MODE_CACHED)
-                {
-                    // 条件变量, 超时返回了
-                    if (notEmpty_.wait_for(lock, std::chrono::seconds(1), [&]()-> bool
-                        {
-                            return taskQue_.size() == 0;
-                        }))
-                    {
-                        auto now = std::chrono::high_resolution_clock::now();
-                        auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - lastTime);
-                        if (duration.count() >= THREAD_TIMEOUT && currentThreadSize_ > initThreadSize_)
-                        {
-                            // 回收线程
-                            // 记录线程数量相关的 需要修改
-                            // 把当前线程从线程列表删除--难点: 没有办法匹配 改线程函数 对应哪个 线程对象
-                            std::cout << "动态创建的线程, 空闲时间超过10s, 回收线程..." << std::endl;
-                            threads_.erase(threadid); // 删除线程对象
-                            // 不要使用 std::this_thread::get_id() 
-
-                            idleThreadSize_--; // 空闲线程数量减1
-                            currentThreadSize_--; // 线程池当前线程总数量减1
-
-
-                            exitCond_.notify_all(); // 通知线程池退出条件变量
-                            return; // 退出线程函数
-
-                        }
-                    }
-
-                }
-                else   //fixed模式
-                {
-                    // 等待任务队列不空
-                    notEmpty_.wait(lock);
-                }
-
-                // 析构时, 唤醒后, 还是会先走这里
-                // 如果线程池不在运行状态, 则退出线程函数
-                // 析构情况1 : 原本就是等待
-                // 死锁优化
-                // if (!isPoolRunning_)
-                // {
-                //     threads_.erase(threadid); // 删除线程对象
-                //     std::cout << "Thread " << std::this_thread::get_id()
-                //         << "线程池不在运行状态, 回收线程..." << std::endl;
-                //     exitCond_.notify_all(); // 通知线程池退出条件变量
-                //     return;
-                // }
-
-
-            }
-
-
-            std::cout << "Thread " << std::this_thread::get_id()
-                << "获取到任务, 开始执行..." << std::endl;
-
-            idleThreadSize_--; // 空闲线程数量减1
-
-            // 取出任务
-            task = taskQue_.front();
-            taskQue_.pop();
-            --taskSize_;
-
-            // -- 复现死锁本人解决办法
-            // startCond_.notify_all();
-
-            // 如果还有任务, 通知其他的线程执行
-            if (taskQue_.size() > 0)
-            {
-                notEmpty_.notify_all(); // 通知其他线程有任务了
-            }
-
-            // 通知任务队列不满
-            notFull_.notify_all();
-
-            // 解锁
-            // lock.unlock();
-        }
-        // 执行任务
-        if (task != nullptr)
-        {
-            // task->run(); // 执行任务
-            task->exec(); // 执行任务
-        }
-
-        idleThreadSize_++; // 空闲线程数量加1
-
-        // 位置要注意, 这记录的是  任务执行完的时间
-        lastTime = std::chrono::high_resolution_clock::now(); // 更新线程开始时间
+        pool_->leaveBlocking();
     }
-
-
-
 }
 
 #if 0
@@ -466,6 +234,13 @@ void ThreadPool::threadFunc(int threadid)
 // **************************task实现*****************************
 Task::Task()
     : result_(nullptr) // 初始化任务执行结果为nullptr
+    , pool_(nullptr)
+    , claimed_(false)
+    , queuedBytes_(0)
+    , enqueueNs_(0)
+    , tag_(0)
+    , submitThread_(0)
+    , submitNs_(0)
 {}
 
 
@@ -485,28 +260,103 @@ void Task::exec()
 }
 void Task::setResult(Result* res)
 {
-    // 设置任务执行结果
-    result_ = res;
+    // 设置任务执行结果, 持有的是共享的完成状态, 不是Result本身
+    result_ = res->completion_;
 }
 
-// **************************线程方法实现*****************************
-// 构造函数，传入线程函数
-int Thread::generate_id = 0; // 静态变量, 用于生成唯一的线程ID
+// **************************CancellationToken实现*****************************
+CancellationToken::CancellationToken()
+    : state_(std::make_shared<State>())
+{}
+
+void CancellationToken::cancel()
+{
+    if (state_ == nullptr)
+    {
+        return;
+    }
+    state_->cancelled_ = true;
+
+    std::vector<std::weak_ptr<Task>> tasks;
+    {
+        std::lock_guard<std::mutex> guard(state_->mutex_);
+        tasks.swap(state_->tasks_);
+    }
+    for (auto& weak : tasks)
+    {
+        std::shared_ptr<Task> task = weak.lock();
+        // 抢到执行权的说明还在排队, 抢不到的已经在执行或者执行完了
+        if (task != nullptr && task->tryClaim())
+        {
+            task->pool_->cancelQueuedTask(task.get());
+        }
+    }
+}
 
-Thread::Thread(ThreadFunc func)
+bool CancellationToken::isCancelled() const
+{
+    return state_ != nullptr && state_->cancelled_;
+}
+
+bool CancellationToken::track(const std::shared_ptr<Task>& task)
+{
+    if (state_ == nullptr)
+    {
+        return true;
+    }
+    std::lock_guard<std::mutex> guard(state_->mutex_);
+    // cancel()先置标志再加锁取列表, 所以这里看不到标志的话一定会被cancel()取到
+    if (state_->cancelled_)
+    {
+        return false;
+    }
+    if (state_->tasks_.size() >= state_->pruneSize_)
+    {
+        // 已经开始执行的任务不用再登记, 均摊下来每次登记O(1)
+        auto& tasks = state_->tasks_;
+        size_t keep = 0;
+        for (size_t i = 0; i < tasks.size(); ++i)
+        {
+            std::shared_ptr<Task> t = tasks[i].lock();
+            if (t != nullptr && !t->claimed_)
+            {
+                tasks[keep++] = tasks[i];
+            }
+        }
+        tasks.resize(keep);
+        state_->pruneSize_ = std::max<size_t>(16, keep * 2);
+    }
+    state_->tasks_.emplace_back(task);
+    return true;
+}
+
+// **************************线程方法实现*****************************
+// 构造函数，传入线程函数和线程ID
+Thread::Thread(ThreadFunc func, int threadId)
     : func_(std::move(func))
-    , threadId_(generate_id++) // 生成唯一的线程ID
+    , threadId_(threadId)
 {}
 
 // 析构函数
-Thread::~Thread() {}
+Thread::~Thread()
+{
+    join();
+}
 
 // 启动线程
 void Thread::start()
 {
-    // 创建线程并执行传入的函数
-    std::thread t(func_, threadId_); // 传入线程ID
-    t.detach(); // 分离线程
+    // 创建线程并执行传入的函数, 不分离, 线程池退出时join
+    thread_ = std::thread(func_, threadId_); // 传入线程ID
+}
+
+// 等待线程结束
+void Thread::join()
+{
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
 }
 
 // 获取线程ID
@@ -516,24 +366,122 @@ int Thread::getThreadId() const
 }
 
 // **************************Result实现*****************************
-Result::Result(std::shared_ptr<Task> task, bool isReady)
-    : task_(task), isReady_(isReady)
+Result::Result(std::shared_ptr<Task> task, bool isValid)
+    : completion_(std::make_shared<Completion>()), task_(task), isValid_(isValid)
 {
-    task_->setResult(this); // 将本对象作为任务的成员, 用于接收返回值
+    task_->setResult(this); // 将完成状态交给任务, 用于接收返回值
 }
 
 Any Result::get()
 {
-    // 等待任务完成
-    sem_.wait();
+    if (!isValid_)
+    {
+        // 提交失败的任务永远不会执行, 不能在这里等
+        return Any();
+    }
+    // 工作线程里等待其他任务的话, 先帮忙执行任务, 不然可能把线程池卡死
+    if (!completion_->isReady())
+    {
+        ThreadPoolBase::helpWhileWaiting(task_.get(), completion_.get());
+    }
+    // 等待任务完成, 返回任务结果
+    return completion_->get();
+}
 
-    // 返回任务结果
+void Result::setValue(Any any)
+{
+    completion_->setValue(std::move(any));
+}
+
+// **************************Completion实现*****************************
+Any Completion::get()
+{
+    // 已经完成就不用碰信号量
+    if (!isReady())
+    {
+        sem_.wait();
+    }
     return std::move(any_);
 }
 
-void Result::setValue(Any any)
+void Completion::setValue(Any any)
 {
     // 存储task返回值
     this->any_ = std::move(any);
+    isReady_.store(true, std::memory_order_release);
     sem_.post(); // 任务完成, 通知等待的线程
+
+    // 通知挂着的计数器, 和attach()抢, 谁后到谁负责arrive
+    CountDownLatch *latch = latch_.exchange(doneMark());
+    if (latch != nullptr)
+    {
+        latch->arrive();
+    }
+}
+
+void Completion::cancel()
+{
+    isCancelled_.store(true, std::memory_order_release);
+    setValue(Any());
+}
+
+void Completion::attach(std::shared_ptr<CountDownLatch> latch)
+{
+    latch->expect();
+    latchRef_ = latch;
+    CountDownLatch *expected = nullptr;
+    if (!latch_.compare_exchange_strong(expected, latch.get()))
+    {
+        // 任务已经完成了
+        latch->arrive();
+    }
+}
+
+// **************************ResultSet实现*****************************
+ResultSet::ResultSet()
+    : latch_(std::make_shared<CountDownLatch>())
+{}
+
+size_t ResultSet::add(Result res)
+{
+    if (res.isValid())
+    {
+        res.completion_->attach(latch_);
+    }
+    else
+    {
+        // 提交失败的任务不会执行, 直接算完成
+        latch_->expect();
+        latch_->arrive();
+    }
+    results_.emplace_back(std::move(res));
+    return results_.size() - 1;
+}
+
+void ResultSet::wait_all()
+{
+    latch_->waitAll();
+}
+
+int ResultSet::wait_any()
+{
+    if (results_.empty())
+    {
+        return -1;
+    }
+    latch_->waitAny();
+    return firstReady();
+}
+
+int ResultSet::firstReady() const
+{
+    for (size_t i = 0; i < results_.size(); ++i)
+    {
+        const Result &res = results_[i];
+        if (!res.isValid() || res.isReady())
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
 }
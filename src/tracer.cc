@@ -0,0 +1,207 @@
+#include "tracer.h"
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+
+namespace
+{
+    // 一条事件记录
+    struct TraceRecord
+    {
+        int64_t ns_;       // steady_clock时间
+        const void* task_; // 相关的任务, 线程事件为nullptr
+        TraceEvent event_;
+    };
+
+    // 一个线程的事件缓冲区, 只有所属线程写, writeChromeTrace读
+    struct TraceBuffer
+    {
+        TraceBuffer(size_t capacity, int tid)
+            : records_(new TraceRecord[capacity]), capacity_(capacity), size_(0), dropped_(0), tid_(tid)
+        {}
+
+        std::unique_ptr<TraceRecord[]> records_;
+        size_t capacity_;
+        std::atomic<size_t> size_;    // 已经写完的记录数量, release发布
+        std::atomic<size_t> dropped_; // 写满后丢弃的数量
+        int tid_;
+    };
+
+    std::mutex registryMutex;                          // 保护下面几个变量, 只在线程第一次记录时用
+    std::vector<std::shared_ptr<TraceBuffer>> buffers; // 本轮所有线程的缓冲区
+    size_t bufferCapacity = 1 << 16;
+    std::atomic_uint generation(0);                    // 每次start()加1, 线程发现变了就换新缓冲区
+    int nextTid = 1;
+
+    // 线程自己持有一份引用, 上一轮的缓冲区被清掉后也不会悬空
+    thread_local std::shared_ptr<TraceBuffer> localBuffer;
+    thread_local unsigned localGeneration = 0;
+
+    TraceBuffer* threadBuffer()
+    {
+        unsigned gen = generation.load(std::memory_order_acquire);
+        if (localBuffer == nullptr || localGeneration != gen)
+        {
+            std::lock_guard<std::mutex> guard(registryMutex);
+            localBuffer = std::make_shared<TraceBuffer>(bufferCapacity, nextTid++);
+            localGeneration = gen;
+            buffers.push_back(localBuffer);
+        }
+        return localBuffer.get();
+    }
+
+    int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    const char* eventName(TraceEvent event)
+    {
+        switch (event)
+        {
+        case TraceEvent::SUBMIT: return "submit";
+        case TraceEvent::ENQUEUE: return "enqueue";
+        case TraceEvent::DEQUEUE: return "dequeue";
+        case TraceEvent::START: return "task";
+        case TraceEvent::END: return "task";
+        case TraceEvent::PARK: return "park";
+        case TraceEvent::UNPARK: return "park";
+        case TraceEvent::SPAWN: return "spawn";
+        case TraceEvent::EXIT: return "exit";
+        }
+        return "unknown";
+    }
+}
+
+std::atomic_bool Tracer::enabled_(false);
+
+void Tracer::start(size_t capacityPerThread)
+{
+    {
+        std::lock_guard<std::mutex> guard(registryMutex);
+        buffers.clear();
+        bufferCapacity = capacityPerThread > 0 ? capacityPerThread : 1;
+        nextTid = 1;
+        generation.fetch_add(1, std::memory_order_release);
+    }
+    enabled_.store(true);
+}
+
+void Tracer::stop()
+{
+    enabled_.store(false);
+}
+
+void Tracer::record(TraceEvent event, const void* task)
+{
+    TraceBuffer* buffer = threadBuffer();
+    size_t n = buffer->size_.load(std::memory_order_relaxed);
+    if (n == buffer->capacity_)
+    {
+        buffer->dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer->records_[n] = TraceRecord{nowNs(), task, event};
+    buffer->size_.store(n + 1, std::memory_order_release);
+}
+
+size_t Tracer::dropped()
+{
+    std::lock_guard<std::mutex> guard(registryMutex);
+    size_t total = 0;
+    for (auto& buffer : buffers)
+    {
+        total += buffer->dropped_.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+bool Tracer::writeChromeTrace(const std::string& path)
+{
+    std::vector<std::shared_ptr<TraceBuffer>> snapshot;
+    {
+        std::lock_guard<std::mutex> guard(registryMutex);
+        snapshot = buffers;
+    }
+
+    std::ofstream out(path);
+    if (!out)
+    {
+        return false;
+    }
+
+    int pid = static_cast<int>(getpid());
+    int64_t base = -1;
+    for (auto& buffer : snapshot)
+    {
+        size_t n = buffer->size_.load(std::memory_order_acquire);
+        if (n > 0 && (base < 0 || buffer->records_[0].ns_ < base))
+        {
+            base = buffer->records_[0].ns_;
+        }
+    }
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    auto begin = [&]() -> std::ofstream&
+    {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        return out;
+    };
+
+    for (auto& buffer : snapshot)
+    {
+        begin() << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid << ",\"tid\":" << buffer->tid_
+            << ",\"args\":{\"name\":\"thread " << buffer->tid_ << "\"}}";
+
+        size_t n = buffer->size_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < n; ++i)
+        {
+            const TraceRecord& rec = buffer->records_[i];
+            double ts = (rec.ns_ - base) / 1000.0; // trace-event用微秒
+            const char* ph = "i";
+            switch (rec.event_)
+            {
+            case TraceEvent::START:
+            case TraceEvent::PARK:
+                ph = "B";
+                break;
+            case TraceEvent::END:
+            case TraceEvent::UNPARK:
+                ph = "E";
+                break;
+            default:
+                break;
+            }
+
+            std::ofstream& line = begin();
+            line << "{\"ph\":\"" << ph << "\",\"name\":\"" << eventName(rec.event_) << "\",\"pid\":" << pid
+                << ",\"tid\":" << buffer->tid_ << ",\"ts\":" << std::fixed << ts;
+            if (ph[0] == 'i')
+            {
+                line << ",\"s\":\"t\"";
+            }
+            if (rec.task_ != nullptr)
+            {
+                line << ",\"args\":{\"task\":\"" << rec.task_ << "\"}";
+            }
+            line << "}";
+
+            // 入队到开始执行之间画一条flow箭头
+            if (rec.task_ != nullptr && (rec.event_ == TraceEvent::ENQUEUE || rec.event_ == TraceEvent::START))
+            {
+                bool enqueue = rec.event_ == TraceEvent::ENQUEUE;
+                begin() << "{\"ph\":\"" << (enqueue ? "s" : "f") << "\",\"name\":\"queued\",\"cat\":\"task\""
+                    << ",\"id\":\"" << rec.task_ << "\",\"pid\":" << pid << ",\"tid\":" << buffer->tid_
+                    << ",\"ts\":" << std::fixed << ts << (enqueue ? "" : ",\"bp\":\"e\"") << "}";
+            }
+        }
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,169 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <thread>
+#include <algorithm>
+#include "threadpool.h"
+
+/*
+重放ThreadPool::startRecording记下的负载
+每个原来的提交线程对应一个重放线程, 按记录的时刻提交任务, 任务忙等记录的耗时
+输出排队时间(提交到开始执行)的分布和线程利用率, 用来比较不同线程池配置在真实流量下的表现
+*/
+
+using Clock = std::chrono::steady_clock;
+
+// 忙等指定时长的合成任务, 记下自己的排队时间
+class SpinTask : public Task
+{
+public:
+    SpinTask(Clock::time_point submitted, uint64_t runNs, double *queueMs, CountDownLatch *finished)
+        : submitted_(submitted), runNs_(runNs), queueMs_(queueMs), finished_(finished) {}
+
+    Any run() override
+    {
+        auto begin = Clock::now();
+        *queueMs_ = std::chrono::duration<double, std::milli>(begin - submitted_).count();
+        auto until = begin + std::chrono::nanoseconds(runNs_);
+        while (Clock::now() < until)
+        {
+        }
+        finished_->arrive();
+        return 0;
+    }
+
+private:
+    Clock::time_point submitted_;
+    uint64_t runNs_;
+    double *queueMs_;
+    CountDownLatch *finished_;
+};
+
+static double percentile(std::vector<double> v, double p)
+{
+    if (v.empty())
+    {
+        return 0;
+    }
+    size_t k = std::min(v.size() - 1, (size_t)(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+static void usage()
+{
+    std::cerr << "用法: workload_replay <记录文件> [线程数] [fixed|cached] [时间倍速]" << std::endl
+        << "  时间倍速: 2表示到达间隔缩短一半(流量翻倍), 任务耗时不变" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        usage();
+        return 1;
+    }
+    ThreadPool::setLogEnabled(false);
+    int threads = argc > 2 ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+    bool cached = argc > 3 && strcmp(argv[3], "cached") == 0;
+    double speed = argc > 4 ? std::atof(argv[4]) : 1.0;
+
+    std::vector<WorkloadRecord> records;
+    if (!WorkloadRecorder::load(argv[1], records))
+    {
+        std::cerr << "记录文件格式不对: " << argv[1] << std::endl;
+        return 1;
+    }
+    if (records.empty())
+    {
+        std::cerr << "记录文件里没有任务" << std::endl;
+        return 1;
+    }
+    // 文件里是按线程分批写的, 按提交时刻重新排
+    std::sort(records.begin(), records.end(), [](const WorkloadRecord &a, const WorkloadRecord &b)
+        {
+            return a.submitNs_ < b.submitNs_;
+        });
+
+    // 按提交线程分组, 记录下标
+    std::map<uint32_t, std::vector<size_t>> producers;
+    uint64_t totalRunNs = 0;
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        producers[records[i].thread_].push_back(i);
+        totalRunNs += records[i].runNs_;
+    }
+    std::cout << "任务: " << records.size() << "  提交线程: " << producers.size()
+        << "  记录时长: " << records.back().submitNs_ / 1e6 << "ms"
+        << "  总执行时间: " << totalRunNs / 1e6 << "ms" << std::endl;
+    std::cout << "重放: " << threads << "个线程 " << (cached ? "cached" : "fixed")
+        << "模式  倍速: " << speed << std::endl;
+
+    ThreadPool pool;
+    pool.setTaskQueMaxThreshHold(INT32_MAX);
+    if (cached)
+    {
+        pool.setMode(PoolMode::MODE_CACHED);
+    }
+    pool.start(threads);
+
+    std::vector<double> queueMs(records.size(), -1);
+    CountDownLatch finished;
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        finished.expect();
+    }
+    auto begin = Clock::now();
+    std::vector<std::thread> submitters;
+    for (auto &producer : producers)
+    {
+        const std::vector<size_t> *indexes = &producer.second;
+        submitters.emplace_back([&, indexes]()
+            {
+                for (size_t i : *indexes)
+                {
+                    auto at = begin + std::chrono::nanoseconds((uint64_t)(records[i].submitNs_ / speed));
+                    std::this_thread::sleep_until(at);
+                    auto task = std::make_shared<SpinTask>(Clock::now(), records[i].runNs_, &queueMs[i], &finished);
+                    task->setTag(records[i].tag_);
+                    if (!pool.submitTask(task).isValid())
+                    {
+                        finished.arrive();
+                    }
+                }
+            });
+    }
+    for (std::thread &t : submitters)
+    {
+        t.join();
+    }
+    finished.waitAll();
+    double wallMs = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+
+    std::vector<double> delays;
+    for (double ms : queueMs)
+    {
+        if (ms >= 0)
+        {
+            delays.push_back(ms);
+        }
+    }
+    double sum = 0;
+    for (double ms : delays)
+    {
+        sum += ms;
+    }
+    // 利用率: 执行时间占线程可用时间的比例, cached模式按最终线程数算, 只是个近似
+    size_t poolThreads = std::max<size_t>(1, pool.threadSize());
+    std::cout << "耗时: " << wallMs << "ms  执行: " << delays.size() << "  失败: " << records.size() - delays.size() << std::endl
+        << "排队时间  平均: " << (delays.empty() ? 0 : sum / delays.size()) << "ms"
+        << "  p50: " << percentile(delays, 0.5) << "ms"
+        << "  p99: " << percentile(delays, 0.99) << "ms"
+        << "  最大: " << percentile(delays, 1.0) << "ms" << std::endl
+        << "利用率: " << totalRunNs / 1e6 / (wallMs * poolThreads) * 100 << "%"
+        << "  (线程数 " << poolThreads << ")" << std::endl;
+    return 0;
+}